@@ -0,0 +1,359 @@
+//
+//  AsyncLogger.h
+//
+//  Debug log writer for the DDW plugin.
+//  log() only copies the format pointer and the raw arguments into a slot of a lock free ring
+//  buffer and returns, a background thread formats the records, adds the timestamps and writes
+//  them to the file in batches. The format must be a literal, strings are copied since they may
+//  not live until the writer gets to them. Only the conversions the driver uses are supported
+//  (d i u o x X c, f F e E g G, s with the h l ll modifiers).
+//  Any thread can log. If the ring is full the record is dropped and counted.
+//  Records are stamped with a steady clock in microseconds, the writer turns that into wall clock
+//  time from a reference taken when the log is opened and only reformats the date once per second.
+//
+
+#ifndef __ASYNC_LOGGER__
+#define __ASYNC_LOGGER__
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <string>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <type_traits>
+
+#define LOG_RECORD_SIZE     256     // bytes of arguments in a record, also the longest message written
+#define LOG_RING_SIZE       1024    // must be a power of 2
+#define LOG_BATCH_SIZE      65536
+#define LOG_WRITER_SLEEP_MS 100
+
+// steady clock timestamps for the logs and traces
+class CLogClock
+{
+public:
+    CLogClock() { setReference(); }
+
+    static inline long long nowUs()
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // wall clock time of nowUs() == m_nRefSteadyUs
+    void setReference()
+    {
+        m_nRefSteadyUs = nowUs();
+        m_nRefWallUs = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+        m_tCachedSec = -1;
+        m_szPrefix[0] = 0;
+    }
+
+    // "Fri Oct 16 2026 23:02:41.123456", the date part is only recomputed when the second changes.
+    int format(long long nSteadyUs, char *pszOut, size_t nMaxLen)
+    {
+        long long nWallUs = m_nRefWallUs + (nSteadyUs - m_nRefSteadyUs);
+        time_t tSec = (time_t)(nWallUs / 1000000);
+        struct tm tmLocal;
+
+        if(tSec != m_tCachedSec) {
+            m_tCachedSec = tSec;
+#ifdef SB_WIN_BUILD
+            localtime_s(&tmLocal, &tSec);
+#else
+            localtime_r(&tSec, &tmLocal);
+#endif
+            strftime(m_szPrefix, sizeof(m_szPrefix), "%a %b %d %Y %H:%M:%S", &tmLocal);
+        }
+        return snprintf(pszOut, nMaxLen, "%s.%06d", m_szPrefix, (int)(nWallUs % 1000000));
+    }
+
+protected:
+    long long   m_nRefSteadyUs;
+    long long   m_nRefWallUs;
+    time_t      m_tCachedSec;
+    char        m_szPrefix[32];
+};
+
+enum logArgType {LOG_ARG_INT = 0, LOG_ARG_DOUBLE, LOG_ARG_STRING};
+
+class CAsyncLogger
+{
+public:
+    CAsyncLogger()
+    {
+        unsigned int i;
+
+        m_pFile = NULL;
+        m_bRunning = false;
+        m_bAccepting = false;
+        m_nLogging = 0;
+        m_nEnqueuePos = 0;
+        m_nDequeuePos = 0;
+        m_nDropped = 0;
+        for(i = 0; i < LOG_RING_SIZE; i++)
+            m_Ring[i].nSeq.store(i, std::memory_order_relaxed);
+    }
+
+    ~CAsyncLogger() { close(); }
+
+    bool open(const std::string &sPath)
+    {
+        close();
+        m_pFile = fopen(sPath.c_str(), "w");
+        if(!m_pFile)
+            return false;
+        m_Clock.setReference();
+        m_bRunning = true;
+        m_Writer = std::thread(&CAsyncLogger::writer, this);
+        m_bAccepting = true;
+        return true;
+    }
+
+    void close()
+    {
+        // no new records, and let the ones being logged land in the ring before the final drain
+        m_bAccepting = false;
+        while(m_nLogging)
+            std::this_thread::yield();
+        if(m_bRunning) {
+            m_bRunning = false;
+            m_Writer.join();
+        }
+        if(m_pFile) {
+            fclose(m_pFile);
+            m_pFile = NULL;
+        }
+    }
+
+    inline bool isOpen() const { return m_bRunning; }
+    inline unsigned int dropped() const { return m_nDropped; }
+
+    template<typename... Args>
+    void log(const char *pszFormat, Args... args)
+    {
+        LogRecord *pRecord;
+        size_t nPos;
+
+        m_nLogging++;   // close() waits for us, checked after so one of us sees the other
+        if(!m_bAccepting) {
+            m_nLogging--;
+            return;
+        }
+
+        pRecord = claim(nPos);
+        if(pRecord) {
+            pRecord->nTimeUs = CLogClock::nowUs();
+            pRecord->pszFormat = pszFormat;
+            pRecord->nArgsLen = 0;
+            pack(*pRecord, args...);
+            pRecord->nSeq.store(nPos + 1, std::memory_order_release);
+        }
+        m_nLogging--;
+    }
+
+protected:
+    typedef struct {
+        std::atomic<size_t> nSeq;
+        long long           nTimeUs;
+        const char          *pszFormat;
+        unsigned int        nArgsLen;
+        unsigned char       args[LOG_RECORD_SIZE];  // a logArgType byte then the value, for each argument
+    } LogRecord;
+
+    // a free slot of the ring, NULL if it's full
+    LogRecord *claim(size_t &nPos)
+    {
+        LogRecord *pRecord;
+        size_t nSeq;
+        long nDiff;
+
+        nPos = m_nEnqueuePos.load(std::memory_order_relaxed);
+        for(;;) {
+            pRecord = &m_Ring[nPos & (LOG_RING_SIZE - 1)];
+            nSeq = pRecord->nSeq.load(std::memory_order_acquire);
+            nDiff = (long)nSeq - (long)nPos;
+            if(nDiff == 0) {
+                if(m_nEnqueuePos.compare_exchange_weak(nPos, nPos + 1, std::memory_order_relaxed))
+                    return pRecord;
+            }
+            else if(nDiff < 0) {    // full, the writer is behind
+                m_nDropped++;
+                return NULL;
+            }
+            else
+                nPos = m_nEnqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+
+    // copy the arguments, what doesn't fit is printed as '?' by the writer
+    static inline void pack(LogRecord &/*record*/) {}
+
+    template<typename T, typename... Args>
+    static inline void pack(LogRecord &record, T arg, Args... args)
+    {
+        packArg(record, arg);
+        pack(record, args...);
+    }
+
+    template<typename T>
+    static inline typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value>::type packArg(LogRecord &record, T arg)
+    {
+        long long nValue = (long long)arg;
+        packValue(record, LOG_ARG_INT, &nValue, sizeof(nValue));
+    }
+
+    template<typename T>
+    static inline typename std::enable_if<std::is_floating_point<T>::value>::type packArg(LogRecord &record, T arg)
+    {
+        double dValue = (double)arg;
+        packValue(record, LOG_ARG_DOUBLE, &dValue, sizeof(dValue));
+    }
+
+    static inline void packArg(LogRecord &record, const char *pszArg)
+    {
+        unsigned int nFree = LOG_RECORD_SIZE - record.nArgsLen;
+        unsigned int nLen;
+
+        if(nFree < 2)
+            return;
+        if(!pszArg)
+            pszArg = "(null)";
+        // truncated to what's left, always terminated
+        for(nLen = 0; nLen < nFree - 2 && pszArg[nLen]; nLen++)
+            ;
+        record.args[record.nArgsLen] = LOG_ARG_STRING;
+        memcpy(record.args + record.nArgsLen + 1, pszArg, nLen);
+        record.args[record.nArgsLen + 1 + nLen] = 0;
+        record.nArgsLen += nLen + 2;
+    }
+
+    static inline void packValue(LogRecord &record, unsigned char nType, const void *pValue, unsigned int nSize)
+    {
+        if(record.nArgsLen + 1 + nSize > LOG_RECORD_SIZE)
+            return;
+        record.args[record.nArgsLen] = nType;
+        memcpy(record.args + record.nArgsLen + 1, pValue, nSize);
+        record.nArgsLen += nSize + 1;
+    }
+
+    // printf the record's format with its arguments, one conversion at a time. Returns the length.
+    static size_t format(const LogRecord &record, char *pszOut, size_t nMaxLen)
+    {
+        const char *pszFmt = record.pszFormat;
+        const unsigned char *pArg = record.args;
+        const unsigned char *pEnd = record.args + record.nArgsLen;
+        char szSpec[16];
+        size_t nLen = 0;
+        size_t nSpecLen;
+        long long nValue;
+        double dValue;
+        int nWritten;
+        char cConv;
+
+        while(*pszFmt && nLen < nMaxLen - 1) {
+            if(*pszFmt != '%' || pszFmt[1] == '%') {
+                pszOut[nLen++] = *pszFmt;
+                pszFmt += *pszFmt == '%' ? 2 : 1;
+                continue;
+            }
+            nSpecLen = strcspn(pszFmt + 1, "diouxXcfFeEgGs") + 2;
+            if(!pszFmt[nSpecLen - 1] || nSpecLen >= sizeof(szSpec))
+                break;  // not something we know how to format
+            memcpy(szSpec, pszFmt, nSpecLen);
+            szSpec[nSpecLen] = 0;
+            cConv = szSpec[nSpecLen - 1];
+            pszFmt += nSpecLen;
+
+            nWritten = -1;
+            if(pArg < pEnd) {
+                if(cConv == 's' && *pArg == LOG_ARG_STRING) {
+                    nWritten = snprintf(pszOut + nLen, nMaxLen - nLen, szSpec, (const char *)pArg + 1);
+                }
+                else if(strchr("fFeEgG", cConv) && *pArg == LOG_ARG_DOUBLE) {
+                    memcpy(&dValue, pArg + 1, sizeof(dValue));
+                    nWritten = snprintf(pszOut + nLen, nMaxLen - nLen, szSpec, dValue);
+                }
+                else if(strchr("diouxXc", cConv) && *pArg == LOG_ARG_INT) {
+                    memcpy(&nValue, pArg + 1, sizeof(nValue));
+                    if(strstr(szSpec, "ll"))
+                        nWritten = snprintf(pszOut + nLen, nMaxLen - nLen, szSpec, nValue);
+                    else if(strchr(szSpec, 'l'))
+                        nWritten = snprintf(pszOut + nLen, nMaxLen - nLen, szSpec, (long)nValue);
+                    else
+                        nWritten = snprintf(pszOut + nLen, nMaxLen - nLen, szSpec, (int)nValue);
+                }
+                // skip it even if it doesn't match the conversion
+                pArg += 1 + (*pArg == LOG_ARG_STRING ? strlen((const char *)pArg + 1) + 1 : sizeof(long long));
+            }
+            if(nWritten < 0)
+                pszOut[nLen++] = '?';   // missing or of the wrong type
+            else
+                nLen += (size_t)nWritten < nMaxLen - nLen ? (size_t)nWritten : nMaxLen - nLen - 1;
+        }
+        pszOut[nLen] = 0;
+        return nLen;
+    }
+
+    // pop and format as many records as fit in the batch buffer, returns the number of bytes.
+    size_t drain()
+    {
+        LogRecord *pRecord;
+        size_t nPos;
+        size_t nLen = 0;
+        char szTime[48];
+        int nWritten;
+
+        nPos = m_nDequeuePos;
+        while(nLen < LOG_BATCH_SIZE - 2*LOG_RECORD_SIZE) {
+            pRecord = &m_Ring[nPos & (LOG_RING_SIZE - 1)];
+            if(pRecord->nSeq.load(std::memory_order_acquire) != nPos + 1)
+                break;  // empty
+            m_Clock.format(pRecord->nTimeUs, szTime, sizeof(szTime));
+            nWritten = snprintf(m_szBatch + nLen, LOG_BATCH_SIZE - nLen, "[%s] ", szTime);
+            if(nWritten > 0)
+                nLen += nWritten;   // always fits, we keep room for a full record
+            nLen += format(*pRecord, m_szBatch + nLen, LOG_RECORD_SIZE);
+            pRecord->nSeq.store(nPos + LOG_RING_SIZE, std::memory_order_release);
+            nPos++;
+        }
+        m_nDequeuePos = nPos;
+        return nLen;
+    }
+
+    void writer()
+    {
+        size_t nLen;
+        unsigned int nReported = 0;
+
+        for(;;) {
+            // read the flag before draining so nothing logged before close() is lost
+            bool bRunning = m_bRunning;
+            while((nLen = drain()) != 0)
+                fwrite(m_szBatch, 1, nLen, m_pFile);
+            if(m_nDropped != nReported) {
+                fprintf(m_pFile, "[CAsyncLogger] %u log records dropped\n", m_nDropped - nReported);
+                nReported = m_nDropped;
+            }
+            fflush(m_pFile);
+            if(!bRunning)
+                break;
+            std::this_thread::sleep_for(std::chrono::milliseconds(LOG_WRITER_SLEEP_MS));
+        }
+    }
+
+    FILE                        *m_pFile;
+    CLogClock                   m_Clock;    // only used by the writer
+    std::thread                 m_Writer;
+    std::atomic<bool>           m_bRunning;
+    std::atomic<bool>           m_bAccepting;   // cleared by close() before the final drain
+    std::atomic<int>            m_nLogging;     // log() calls in progress
+    std::atomic<size_t>         m_nEnqueuePos;
+    size_t                      m_nDequeuePos;  // only used by the writer
+    std::atomic<unsigned int>   m_nDropped;
+    LogRecord                   m_Ring[LOG_RING_SIZE];
+    char                        m_szBatch[LOG_BATCH_SIZE];
+};
+
+#endif
@@ -0,0 +1,183 @@
+//
+//  AzTracker.h
+//
+//  Dead reckoning of the dome azimuth while it rotates.
+//  The controller reports a rotation with a T per encoder tick, in the direction of the L or R
+//  that started it, or with Pnnnn positions. Each message is integrated at the time it was
+//  received and the rotation speed is estimated from them, so the azimuth can be interpolated
+//  between messages and between polls. The estimate doesn't go past the goto target and stops
+//  moving TRACKER_MAX_EXTRAPOLATION seconds after the last message.
+//  Times are in seconds on the caller's clock, azimuths in degrees.
+//
+
+#ifndef __AZ_TRACKER__
+#define __AZ_TRACKER__
+
+#include <math.h>
+
+#define TRACKER_MAX_EXTRAPOLATION   2.0     // seconds
+#define TRACKER_MIN_INTERVAL        0.02    // seconds, messages read together share their time
+#define TRACKER_SMOOTHING           0.5     // weight of the newest speed measurement
+
+// what the estimate needs, published with the dome state
+typedef struct {
+    bool    bTracking;
+    double  dAz;        // last reported azimuth
+    double  dTime;      // when it was received
+    double  dRate;      // deg/s, > 0 when the azimuth increases
+    double  dLimit;     // how far from dAz the estimate may go, < 0 : no limit
+} AzTrack;
+
+class CAzTracker
+{
+public:
+    CAzTracker()
+    {
+        m_dDegPerTick = 0;
+        m_bHasTarget = false;
+        m_dTarget = 0;
+        stop();
+    }
+
+    inline void setDegPerTick(double dDegPerTick) { m_dDegPerTick = dDegPerTick; }
+
+    // the goto in progress, if any
+    inline void setTarget(double dAz) { m_dTarget = dAz; m_bHasTarget = true; }
+    inline void clearTarget() { m_bHasTarget = false; }
+
+    // the dome stopped (INF record)
+    void stop()
+    {
+        m_Track.bTracking = false;
+        m_Track.dAz = 0;
+        m_Track.dTime = 0;
+        m_Track.dRate = 0;
+        m_Track.dLimit = -1;
+        m_nDirection = 0;
+    }
+
+    inline bool isTracking() const { return m_Track.bTracking; }
+
+    // L or R (nDirection -1 or 1), the dome starts rotating from dAz
+    void start(double dAz, int nDirection, double dNow)
+    {
+        if(!m_Track.bTracking)
+            begin(dAz, dNow);
+        else if(nDirection != m_nDirection) {
+            m_Track.dRate = 0;  // reversing
+            m_dRefRate = 0;
+        }
+        m_nDirection = nDirection;
+    }
+
+    // T : one tick in the current direction. Returns false if we don't know where we're going.
+    bool tick(double dNow, double &dAz)
+    {
+        if(!m_Track.bTracking || !m_nDirection || m_dDegPerTick <= 0)
+            return false;
+        sample(m_Track.dAz + m_nDirection * m_dDegPerTick, dNow);
+        dAz = m_Track.dAz;
+        return true;
+    }
+
+    // Pnnnn converted to degrees
+    void position(double dAz, double dNow)
+    {
+        if(!m_Track.bTracking)
+            begin(dAz, dNow);
+        else
+            sample(dAz, dNow);
+    }
+
+    AzTrack track() const
+    {
+        AzTrack track = m_Track;
+        double dAhead;
+
+        track.dLimit = -1;
+        if(m_bHasTarget && track.dRate != 0) {
+            dAhead = delta(m_dTarget - track.dAz) * (track.dRate > 0 ? 1 : -1);
+            track.dLimit = dAhead > 0 ? dAhead : 0;
+        }
+        return track;
+    }
+
+    static double estimate(const AzTrack &track, double dNow)
+    {
+        double dElapsed;
+        double dMove;
+
+        if(!track.bTracking)
+            return track.dAz;
+        dElapsed = dNow - track.dTime;
+        if(dElapsed <= 0)
+            return track.dAz;
+        if(dElapsed > TRACKER_MAX_EXTRAPOLATION)
+            dElapsed = TRACKER_MAX_EXTRAPOLATION;
+        dMove = track.dRate * dElapsed;
+        if(track.dLimit >= 0 && fabs(dMove) > track.dLimit)
+            dMove = dMove > 0 ? track.dLimit : -track.dLimit;
+        return normalize(track.dAz + dMove);
+    }
+
+    static inline double normalize(double dAz)
+    {
+        dAz = fmod(dAz, 360.0);
+        return dAz < 0 ? dAz + 360.0 : dAz;
+    }
+
+    // shortest signed angle, -180 to 180
+    static inline double delta(double dAngle)
+    {
+        dAngle = fmod(dAngle, 360.0);
+        if(dAngle > 180.0)
+            dAngle -= 360.0;
+        else if(dAngle < -180.0)
+            dAngle += 360.0;
+        return dAngle;
+    }
+
+protected:
+    void begin(double dAz, double dNow)
+    {
+        m_Track.bTracking = true;
+        m_Track.dAz = normalize(dAz);
+        m_Track.dTime = dNow;
+        m_Track.dRate = 0;
+        m_dRefAz = m_Track.dAz;
+        m_dRefTime = dNow;
+        m_dRefRate = 0;
+    }
+
+    // the speed is measured from the last message of the previous read to the newest one
+    void sample(double dAz, double dNow)
+    {
+        double dElapsed;
+        double dRate;
+
+        if(dNow - m_Track.dTime >= TRACKER_MIN_INTERVAL) {  // the previous read is complete
+            m_dRefAz = m_Track.dAz;
+            m_dRefTime = m_Track.dTime;
+            m_dRefRate = m_Track.dRate;
+        }
+        dAz = normalize(dAz);
+        dElapsed = dNow - m_dRefTime;
+        if(dElapsed >= TRACKER_MIN_INTERVAL) {
+            dRate = delta(dAz - m_dRefAz) / dElapsed;
+            m_Track.dRate = m_dRefRate == 0 ? dRate : m_dRefRate + TRACKER_SMOOTHING * (dRate - m_dRefRate);
+        }
+        m_Track.dAz = dAz;
+        m_Track.dTime = dNow;
+    }
+
+    AzTrack m_Track;
+    int     m_nDirection;   // from L/R, 0 : unknown
+    double  m_dDegPerTick;
+    double  m_dRefAz;       // speed is measured from here
+    double  m_dRefTime;
+    double  m_dRefRate;
+    bool    m_bHasTarget;
+    double  m_dTarget;
+};
+
+#endif
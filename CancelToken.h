@@ -0,0 +1,50 @@
+//
+//  CancelToken.h
+//
+//  Cooperative cancellation of the blocking sequences (serial reads, command retries, waiting for
+//  the dome). Any thread can hold a CCancelRequest on the token, the blocking code checks
+//  isCancelled() at least every CANCEL_CHECK_MS and gives up. The request ends when the
+//  CCancelRequest goes out of scope, so abort, disconnect and the dialog Cancel can overlap.
+//
+
+#ifndef __CANCEL_TOKEN__
+#define __CANCEL_TOKEN__
+
+#include <atomic>
+
+#include "../../licensedinterfaces/sleeperinterface.h"
+
+#define CANCEL_CHECK_MS 100
+
+class CCancelToken
+{
+public:
+    CCancelToken() { m_nRequests = 0; }
+
+    inline bool isCancelled() const { return m_nRequests.load() > 0; }
+
+    // SleeperInterface::sleep can't be interrupted, sleep in slices. Returns false if cancelled.
+    bool sleep(SleeperInterface *pSleeper, int nMs) const
+    {
+        while(nMs > 0 && !isCancelled()) {
+            pSleeper->sleep(nMs < CANCEL_CHECK_MS ? nMs : CANCEL_CHECK_MS);
+            nMs -= CANCEL_CHECK_MS;
+        }
+        return !isCancelled();
+    }
+
+protected:
+    friend class CCancelRequest;
+    std::atomic<int>    m_nRequests;
+};
+
+class CCancelRequest
+{
+public:
+    CCancelRequest(CCancelToken &token) : m_Token(token) { m_Token.m_nRequests++; }
+    ~CCancelRequest() { m_Token.m_nRequests--; }
+private:
+    CCancelToken &m_Token;
+};
+
+#endif
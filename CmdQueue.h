@@ -0,0 +1,101 @@
+//
+//  CmdQueue.h
+//
+//  Outgoing commands waiting for the I/O thread, by priority.
+//  STOP isn't queued, it's written at once and the moves that haven't been sent yet are dropped
+//  with cancelMotion(). Motion commands (Gnnn, GHOM, GOPN, GCLS, GTRN) go out in the order they were queued and
+//  status queries last. A status query already waiting absorbs the new ones, so several GINF
+//  requests become a single transmission.
+//  Each command can have a deadline (on the caller's clock, in ms), it is dropped if it couldn't
+//  be sent by then. Callers serialize the access.
+//
+
+#ifndef __CMD_QUEUE__
+#define __CMD_QUEUE__
+
+#include <string>
+#include <deque>
+
+enum ddwCmdPriority {CMD_PRIO_MOTION = 0, CMD_PRIO_STATUS, DDW_NB_CMD_PRIOS};
+
+typedef struct {
+    std::string sCmd;
+    long long   nDeadlineMs;    // 0 : no deadline
+} QueuedCmd;
+
+class CCmdQueue
+{
+public:
+    CCmdQueue() { clear(); }
+
+    void clear()
+    {
+        for(int i = 0; i < DDW_NB_CMD_PRIOS; i++)
+            m_Queues[i].clear();
+        m_nCoalesced = 0;
+        m_nExpired = 0;
+    }
+
+    // returns false if the command was merged with one already waiting
+    bool push(const std::string &sCmd, int nPriority, long long nDeadlineMs = 0)
+    {
+        std::deque<QueuedCmd> &queue = m_Queues[nPriority];
+        QueuedCmd cmd;
+
+        if(nPriority == CMD_PRIO_STATUS) {
+            for(QueuedCmd &pending : queue) {
+                if(pending.sCmd != sCmd)
+                    continue;
+                if(!nDeadlineMs || (pending.nDeadlineMs && nDeadlineMs > pending.nDeadlineMs))
+                    pending.nDeadlineMs = nDeadlineMs;
+                m_nCoalesced++;
+                return false;
+            }
+        }
+
+        cmd.sCmd = sCmd;
+        cmd.nDeadlineMs = nDeadlineMs;
+        queue.push_back(cmd);
+        return true;
+    }
+
+    // we're stopping, don't start anything else
+    inline void cancelMotion() { m_Queues[CMD_PRIO_MOTION].clear(); }
+
+    // next command to send, highest priority first. Commands past their deadline are dropped.
+    bool pop(std::string &sCmd, long long nNowMs)
+    {
+        for(int i = 0; i < DDW_NB_CMD_PRIOS; i++) {
+            while(!m_Queues[i].empty()) {
+                QueuedCmd &cmd = m_Queues[i].front();
+                if(cmd.nDeadlineMs && cmd.nDeadlineMs < nNowMs) {
+                    m_nExpired++;
+                    m_Queues[i].pop_front();
+                    continue;
+                }
+                sCmd = cmd.sCmd;
+                m_Queues[i].pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    inline bool empty() const
+    {
+        for(int i = 0; i < DDW_NB_CMD_PRIOS; i++)
+            if(!m_Queues[i].empty())
+                return false;
+        return true;
+    }
+
+    inline unsigned long coalesced() const { return m_nCoalesced; }
+    inline unsigned long expired() const { return m_nExpired; }
+
+protected:
+    std::deque<QueuedCmd>   m_Queues[DDW_NB_CMD_PRIOS];
+    unsigned long           m_nCoalesced;
+    unsigned long           m_nExpired;
+};
+
+#endif
@@ -0,0 +1,260 @@
+//
+//  CmdStats.h
+//
+//  Per command type statistics of the exchanges with the DDW controller.
+//  For each command type (GINF, Gnnn, GHOM, GOPN, GCLS, GTRN, STOP) we keep latency histograms
+//  of the write to the port, of the controller response and of the whole command including the
+//  retries, plus retry, timeout, failure and byte counts.
+//  Histograms are log-linear (HDR style) in microseconds : 16 linear sub-buckets per power of 2,
+//  so any value is known to about 6%, from 1us to a couple of minutes, in a fixed 1.5KB array.
+//
+
+#ifndef __CMD_STATS__
+#define __CMD_STATS__
+
+#include <stdio.h>
+#include <string.h>
+
+#include <string>
+#include <mutex>
+
+#define HIST_SUB_BITS       5
+#define HIST_SUB_COUNT      (1 << HIST_SUB_BITS)
+#define HIST_HALF_COUNT     (HIST_SUB_COUNT / 2)
+#define HIST_MAX_BITS       27      // 2^27 us, 134s
+#define HIST_NB_BUCKETS     (HIST_SUB_COUNT + (HIST_MAX_BITS - HIST_SUB_BITS) * HIST_HALF_COUNT)
+
+enum ddwCmdType {DDW_CMD_GINF = 0, DDW_CMD_GOTO, DDW_CMD_GHOM, DDW_CMD_GOPN, DDW_CMD_GCLS, DDW_CMD_GTRN, DDW_CMD_STOP, DDW_CMD_OTHER, DDW_NB_CMD_TYPES};
+
+class CLatencyHistogram
+{
+public:
+    CLatencyHistogram() { reset(); }
+
+    void reset()
+    {
+        memset(m_nCounts, 0, sizeof(m_nCounts));
+        m_nCount = 0;
+        m_nMin = 0;
+        m_nMax = 0;
+        m_nSum = 0;
+    }
+
+    void record(long long nUs)
+    {
+        if(nUs < 0)
+            nUs = 0;
+        m_nCounts[bucket(nUs)]++;
+        if(!m_nCount || nUs < m_nMin)
+            m_nMin = nUs;
+        if(nUs > m_nMax)
+            m_nMax = nUs;
+        m_nSum += nUs;
+        m_nCount++;
+    }
+
+    inline unsigned long count() const { return m_nCount; }
+    inline long long min() const { return m_nMin; }
+    inline long long max() const { return m_nMax; }
+    inline double mean() const { return m_nCount ? double(m_nSum) / m_nCount : 0.0; }
+
+    // highest value equivalent to the recorded ones at this percentile (0..100)
+    long long percentile(double dPercent) const
+    {
+        unsigned long nRank;
+        unsigned long nSeen = 0;
+        int i;
+
+        if(!m_nCount)
+            return 0;
+        nRank = (unsigned long)(dPercent / 100.0 * m_nCount + 0.5);
+        if(nRank < 1)
+            nRank = 1;
+        for(i = 0; i < HIST_NB_BUCKETS; i++) {
+            nSeen += m_nCounts[i];
+            if(nSeen >= nRank)
+                return highestEquivalent(i) < m_nMax ? highestEquivalent(i) : m_nMax;
+        }
+        return m_nMax;
+    }
+
+protected:
+    static int bucket(long long nUs)
+    {
+        int nMsb;
+        int nShift;
+
+        if(nUs < HIST_SUB_COUNT)
+            return (int)nUs;
+        if(nUs >= (1LL << HIST_MAX_BITS))
+            return HIST_NB_BUCKETS - 1;
+        for(nMsb = HIST_SUB_BITS; (nUs >> (nMsb + 1)) != 0; nMsb++)
+            ;
+        nShift = nMsb - HIST_SUB_BITS + 1;
+        return HIST_SUB_COUNT + (nShift - 1) * HIST_HALF_COUNT + (int)(nUs >> nShift) - HIST_HALF_COUNT;
+    }
+
+    static long long highestEquivalent(int nBucket)
+    {
+        int nShift;
+        long long nMantissa;
+
+        if(nBucket < HIST_SUB_COUNT)
+            return nBucket;
+        nShift = (nBucket - HIST_SUB_COUNT) / HIST_HALF_COUNT + 1;
+        nMantissa = (nBucket - HIST_SUB_COUNT) % HIST_HALF_COUNT + HIST_HALF_COUNT;
+        return ((nMantissa + 1) << nShift) - 1;
+    }
+
+    unsigned int    m_nCounts[HIST_NB_BUCKETS];
+    unsigned long   m_nCount;
+    long long       m_nMin;
+    long long       m_nMax;
+    long long       m_nSum;
+};
+
+typedef struct {
+    unsigned long       nCommands;      // commands sent, retries not counted
+    unsigned long       nRetries;       // commands sent again after a timeout
+    unsigned long       nTimeouts;      // reads that timed out
+    unsigned long       nFailures;      // commands that ended in error
+    unsigned long long  nBytesTx;
+    unsigned long long  nBytesRx;
+    long long           nRetrySleepUs;  // time spent sleeping before resending
+    CLatencyHistogram   write;          // writeFile + flushTx, the port / USB adapter side
+    CLatencyHistogram   response;       // end of write to response, for each answered attempt
+    CLatencyHistogram   total;          // whole command, retries and sleeps included
+} CmdTypeStats;
+
+class CCmdStats
+{
+public:
+    CCmdStats() { reset(); }
+
+    static int cmdType(const char *pszCmd)
+    {
+        if(!strncmp(pszCmd, "GINF", 4))
+            return DDW_CMD_GINF;
+        if(!strncmp(pszCmd, "GHOM", 4))
+            return DDW_CMD_GHOM;
+        if(!strncmp(pszCmd, "GOPN", 4))
+            return DDW_CMD_GOPN;
+        if(!strncmp(pszCmd, "GCLS", 4))
+            return DDW_CMD_GCLS;
+        if(!strncmp(pszCmd, "GTRN", 4))
+            return DDW_CMD_GTRN;
+        if(!strncmp(pszCmd, "STOP", 4))
+            return DDW_CMD_STOP;
+        if(pszCmd[0] == 'G' && pszCmd[1] >= '0' && pszCmd[1] <= '9')
+            return DDW_CMD_GOTO;
+        return DDW_CMD_OTHER;
+    }
+
+    static const char *cmdName(int nType)
+    {
+        static const char *names[DDW_NB_CMD_TYPES] = {"GINF", "Gnnn", "GHOM", "GOPN", "GCLS", "GTRN", "STOP", "other"};
+        return (nType >= 0 && nType < DDW_NB_CMD_TYPES) ? names[nType] : "?";
+    }
+
+    void reset()
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        for(int i = 0; i < DDW_NB_CMD_TYPES; i++) {
+            m_Stats[i].nCommands = 0;
+            m_Stats[i].nRetries = 0;
+            m_Stats[i].nTimeouts = 0;
+            m_Stats[i].nFailures = 0;
+            m_Stats[i].nBytesTx = 0;
+            m_Stats[i].nBytesRx = 0;
+            m_Stats[i].nRetrySleepUs = 0;
+            m_Stats[i].write.reset();
+            m_Stats[i].response.reset();
+            m_Stats[i].total.reset();
+        }
+    }
+
+    void recordWrite(int nType, long long nUs, unsigned long nBytes)
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Stats[nType].write.record(nUs);
+        m_Stats[nType].nBytesTx += nBytes;
+    }
+
+    void recordResponse(int nType, long long nUs, unsigned long nBytes)
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Stats[nType].response.record(nUs);
+        m_Stats[nType].nBytesRx += nBytes;
+    }
+
+    void recordTimeout(int nType, unsigned long nBytes)
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Stats[nType].nTimeouts++;
+        m_Stats[nType].nBytesRx += nBytes;
+    }
+
+    void recordRetry(int nType, long long nSleepUs)
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Stats[nType].nRetries++;
+        m_Stats[nType].nRetrySleepUs += nSleepUs;
+    }
+
+    void recordCommand(int nType, long long nUs, bool bFailed)
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Stats[nType].nCommands++;
+        m_Stats[nType].total.record(nUs);
+        if(bFailed)
+            m_Stats[nType].nFailures++;
+    }
+
+    bool get(int nType, CmdTypeStats &stats)
+    {
+        if(nType < 0 || nType >= DDW_NB_CMD_TYPES)
+            return false;
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        stats = m_Stats[nType];
+        return true;
+    }
+
+    void dump(FILE *pFile)
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        fprintf(pFile, "%-6s %8s %7s %8s %8s %10s %10s %10s  %-30s %-30s %-30s\n",
+                "cmd", "count", "retries", "timeouts", "failures", "bytes tx", "bytes rx", "sleep ms",
+                "write us p50/p99/max", "response us p50/p99/max", "total us p50/p99/max");
+        for(int i = 0; i < DDW_NB_CMD_TYPES; i++) {
+            CmdTypeStats &s = m_Stats[i];
+            if(!s.nCommands && !s.write.count())
+                continue;
+            fprintf(pFile, "%-6s %8lu %7lu %8lu %8lu %10llu %10llu %10lld  %-30s %-30s %-30s\n",
+                    cmdName(i), s.nCommands, s.nRetries, s.nTimeouts, s.nFailures, s.nBytesTx, s.nBytesRx, s.nRetrySleepUs / 1000,
+                    summary(s.write).c_str(), summary(s.response).c_str(), summary(s.total).c_str());
+        }
+    }
+
+    bool dump(const std::string &sPath)
+    {
+        FILE *pFile = fopen(sPath.c_str(), "w");
+        if(!pFile)
+            return false;
+        dump(pFile);
+        fclose(pFile);
+        return true;
+    }
+
+protected:
+    static std::string summary(const CLatencyHistogram &h)
+    {
+        char szSummary[64];
+        snprintf(szSummary, sizeof(szSummary), "%lld/%lld/%lld", h.percentile(50), h.percentile(99), h.max());
+        return szSummary;
+    }
+
+    std::mutex      m_Mutex;
+    CmdTypeStats    m_Stats[DDW_NB_CMD_TYPES];
+};
+
+#endif
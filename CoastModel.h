@@ -0,0 +1,151 @@
+//
+//  CoastModel.h
+//
+//  Learned overshoot of the gotos, to aim them so the dome stops on target.
+//  The controller cuts the motor COAST ticks before the target, but where the dome actually
+//  stops depends on the direction and on how fast it was going, so on the slew length. Each
+//  completed goto records how far past the commanded azimuth it stopped (negative when short),
+//  per direction and distance bin. A bin is a running mean for its first samples, then an
+//  exponential average so the model follows the dome (wear, temperature, ...).
+//  Azimuths and distances are in degrees.
+//
+
+#ifndef __COAST_MODEL__
+#define __COAST_MODEL__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include <string>
+
+#define COAST_NB_BINS           4
+#define COAST_MIN_SAMPLES       3       // before a bin is used
+#define COAST_LEARNING_RATE     0.2     // weight of a new goto once the bin is warm
+#define COAST_MAX_OVERSHOOT     10.0    // anything further off isn't coasting (stopped, slipped, ...)
+
+typedef struct {
+    int     nSamples;
+    double  dOvershoot;
+} CoastBin;
+
+class CCoastModel
+{
+public:
+    CCoastModel() { clear(); }
+
+    void clear()
+    {
+        for(int i = 0; i < 2; i++)
+            for(int j = 0; j < COAST_NB_BINS; j++) {
+                m_Bins[i][j].nSamples = 0;
+                m_Bins[i][j].dOvershoot = 0;
+            }
+    }
+
+    // slews shorter than 10 degrees, 30, 90 and longer
+    static inline int bin(double dDistance)
+    {
+        if(dDistance < 10.0)
+            return 0;
+        if(dDistance < 30.0)
+            return 1;
+        if(dDistance < 90.0)
+            return 2;
+        return 3;
+    }
+
+    // nDirection 1 when the azimuth increases, -1 otherwise. Returns false if the sample was rejected.
+    bool record(int nDirection, double dDistance, double dOvershoot)
+    {
+        CoastBin &b = m_Bins[nDirection > 0 ? 1 : 0][bin(dDistance)];
+        double dWeight;
+
+        if(fabs(dOvershoot) > COAST_MAX_OVERSHOOT)
+            return false;
+        b.nSamples++;
+        dWeight = 1.0 / b.nSamples;
+        if(dWeight < COAST_LEARNING_RATE)
+            dWeight = COAST_LEARNING_RATE;
+        b.dOvershoot += dWeight * (dOvershoot - b.dOvershoot);
+        return true;
+    }
+
+    // expected overshoot, from the bin in that direction or a neighbour if it doesn't have enough
+    // samples yet. Further bins don't say much about this slew, it is sent uncompensated.
+    bool predict(int nDirection, double dDistance, double &dOvershoot) const
+    {
+        const CoastBin *pBins = m_Bins[nDirection > 0 ? 1 : 0];
+        int nBin = bin(dDistance);
+
+        if(pBins[nBin].nSamples >= COAST_MIN_SAMPLES) {
+            dOvershoot = pBins[nBin].dOvershoot;
+            return true;
+        }
+        if(nBin > 0 && pBins[nBin - 1].nSamples >= COAST_MIN_SAMPLES) {
+            dOvershoot = pBins[nBin - 1].dOvershoot;
+            return true;
+        }
+        if(nBin < COAST_NB_BINS - 1 && pBins[nBin + 1].nSamples >= COAST_MIN_SAMPLES) {
+            dOvershoot = pBins[nBin + 1].dOvershoot;
+            return true;
+        }
+        return false;
+    }
+
+    // "samples:overshoot" per bin, decreasing direction first, comma separated.
+    // The overshoot is in integer millidegrees so the string doesn't depend on the locale decimal separator.
+    std::string serialize() const
+    {
+        std::string sModel;
+        char szBin[32];
+
+        for(int i = 0; i < 2; i++)
+            for(int j = 0; j < COAST_NB_BINS; j++) {
+                snprintf(szBin, sizeof(szBin), "%s%d:%ld", sModel.size() ? "," : "", m_Bins[i][j].nSamples, lround(m_Bins[i][j].dOvershoot * 1000.0));
+                sModel += szBin;
+            }
+        return sModel;
+    }
+
+    // from serialize(), the model is left empty if the string doesn't parse
+    bool parse(const char *pszModel)
+    {
+        CoastBin bins[2][COAST_NB_BINS];
+        const char *pszPtr = pszModel;
+        char *pszEnd;
+
+        for(int i = 0; i < 2; i++)
+            for(int j = 0; j < COAST_NB_BINS; j++) {
+                if((i || j) && *pszPtr++ != ',') {
+                    clear();
+                    return false;
+                }
+                bins[i][j].nSamples = (int)strtol(pszPtr, &pszEnd, 10);
+                if(pszEnd == pszPtr || *pszEnd != ':' || bins[i][j].nSamples < 0) {
+                    clear();
+                    return false;
+                }
+                pszPtr = pszEnd + 1;
+                bins[i][j].dOvershoot = strtol(pszPtr, &pszEnd, 10) / 1000.0;
+                if(pszEnd == pszPtr || fabs(bins[i][j].dOvershoot) > COAST_MAX_OVERSHOOT) {
+                    clear();
+                    return false;
+                }
+                pszPtr = pszEnd;
+            }
+        if(*pszPtr) {
+            clear();
+            return false;
+        }
+        for(int i = 0; i < 2; i++)
+            for(int j = 0; j < COAST_NB_BINS; j++)
+                m_Bins[i][j] = bins[i][j];
+        return true;
+    }
+
+protected:
+    CoastBin    m_Bins[2][COAST_NB_BINS];   // [decreasing, increasing][distance bin]
+};
+
+#endif
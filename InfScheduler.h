@@ -0,0 +1,73 @@
+//
+//  InfScheduler.h
+//
+//  Picks how often the INF record is polled from what the dome has been doing.
+//  Right after a movement or a state change (shutter, home sensor, azimuth, rain or snow) we poll
+//  fast so the next change shows up quickly. Changing weather readings keep the normal rate.
+//  Then the longer nothing happens the slower we poll, slowest when parked with the shutter closed.
+//  While the dome moves the motion messages tell us everything and the INF record isn't polled.
+//  Times are in seconds on the caller's clock.
+//
+
+#ifndef __INF_SCHEDULER__
+#define __INF_SCHEDULER__
+
+#define INF_FAST_INTERVAL       0.5f    // after activity
+#define INF_NORMAL_INTERVAL     2.0f
+#define INF_QUIET_INTERVAL      5.0f
+#define INF_IDLE_INTERVAL       10.0f
+#define INF_PARKED_INTERVAL     30.0f   // also how old getDomeState() and dapiGetAzEl can be while parked
+
+#define INF_ACTIVE_WINDOW       10.0    // seconds of fast polling after activity
+#define INF_WEATHER_WINDOW      60.0    // seconds at the normal rate after a weather change
+#define INF_QUIET_AFTER         60.0
+#define INF_IDLE_AFTER          300.0
+
+class CInfScheduler
+{
+public:
+    CInfScheduler() { reset(0.0); }
+
+    void reset(double dNow)
+    {
+        m_dLastActivity = dNow;
+        m_dLastWeatherChange = dNow;
+    }
+
+    // the dome moved or is moving, or a command was sent
+    inline void activity(double dNow) { m_dLastActivity = dNow; }
+
+    // a new INF record came in, with what changed since the previous one
+    void record(bool bStateChanged, bool bWeatherChanged, double dNow)
+    {
+        if(bStateChanged)
+            m_dLastActivity = dNow;
+        if(bWeatherChanged)
+            m_dLastWeatherChange = dNow;
+    }
+
+    float interval(double dNow, bool bMoving, bool bParked, bool bShutterClosed) const
+    {
+        double dQuiet;
+
+        if(bMoving)
+            return INF_FAST_INTERVAL;
+
+        dQuiet = dNow - m_dLastActivity;
+        if(dQuiet < INF_ACTIVE_WINDOW)
+            return INF_FAST_INTERVAL;
+        if(dNow - m_dLastWeatherChange < INF_WEATHER_WINDOW || dQuiet < INF_QUIET_AFTER)
+            return INF_NORMAL_INTERVAL;
+        if(bParked && bShutterClosed)
+            return INF_PARKED_INTERVAL;
+        if(dQuiet < INF_IDLE_AFTER)
+            return INF_QUIET_INTERVAL;
+        return INF_IDLE_INTERVAL;
+    }
+
+protected:
+    double  m_dLastActivity;
+    double  m_dLastWeatherChange;
+};
+
+#endif
@@ -0,0 +1,79 @@
+//
+//  RxBuffer.h
+//
+//  Receive buffer for the DDW serial link.
+//  Data is read from the port in bulk and handed to CStreamDecoder, which consumes it as it
+//  completes messages. What data() returns stays valid until the next call to writePtr()/clear().
+//
+
+#ifndef __RX_BUFFER__
+#define __RX_BUFFER__
+
+#include <string.h>
+
+#define RX_BUFFER_SIZE 4096
+
+class CRxBuffer
+{
+public:
+    CRxBuffer() { clear(); }
+
+    inline void clear(void)
+    {
+        m_nHead = 0;
+        m_nTail = 0;
+        m_szBuffer[0] = 0;
+    }
+
+    // number of bytes not yet decoded
+    inline unsigned int size(void) const { return m_nTail - m_nHead; }
+
+    // where to put new data and how much room there is.
+    // The unconsumed data is moved back to the start of the buffer when the end is reached,
+    // if there is still no room nothing was consumed from a full buffer and it is dropped.
+    char *writePtr(unsigned int &nFree)
+    {
+        if(m_nHead == m_nTail)  // everything was consumed, start over
+            clear();
+        else if(m_nTail == RX_BUFFER_SIZE) {
+            if(m_nHead) {
+                memmove(m_szBuffer, m_szBuffer + m_nHead, m_nTail - m_nHead);
+                m_nTail -= m_nHead;
+                m_nHead = 0;
+            }
+            else
+                clear();
+        }
+        nFree = RX_BUFFER_SIZE - m_nTail;
+        return m_szBuffer + m_nTail;
+    }
+
+    // nLen bytes were written at writePtr()
+    inline void commit(unsigned int nLen)
+    {
+        m_nTail += nLen;
+        m_szBuffer[m_nTail] = 0;
+    }
+
+    // the received data not consumed yet
+    inline const char *data(unsigned int &nLen) const
+    {
+        nLen = m_nTail - m_nHead;
+        return m_szBuffer + m_nHead;
+    }
+
+    // nLen bytes from data() were decoded
+    inline void consume(unsigned int nLen)
+    {
+        m_nHead += nLen;
+        if(m_nHead > m_nTail)
+            m_nHead = m_nTail;
+    }
+
+protected:
+    char            m_szBuffer[RX_BUFFER_SIZE + 1];
+    unsigned int    m_nHead;    // start of the data not yet decoded
+    unsigned int    m_nTail;    // end of the received data
+};
+
+#endif
@@ -0,0 +1,70 @@
+//
+//  SeqLock.h
+//
+//  Single writer / multiple readers sequence lock.
+//  Readers never block the writer and never take a lock, they just retry if a write
+//  happened while they were copying the data.
+//  T must be trivially copyable. Writers must be serialized by the caller.
+//
+
+#ifndef __SEQ_LOCK__
+#define __SEQ_LOCK__
+
+#include <string.h>
+#include <atomic>
+
+template <typename T>
+class CSeqLock
+{
+public:
+    CSeqLock()
+    {
+        T empty;
+
+        memset(&empty, 0, sizeof(T));
+        m_nSeq.store(0, std::memory_order_relaxed);
+        write(empty);
+    }
+
+    void write(const T &data)
+    {
+        unsigned long long nWords[NB_WORDS];
+        unsigned int nSeq;
+        int i;
+
+        memset(nWords, 0, sizeof(nWords));
+        memcpy(nWords, &data, sizeof(T));
+
+        nSeq = m_nSeq.load(std::memory_order_relaxed);
+        m_nSeq.store(nSeq + 1, std::memory_order_relaxed);  // odd : write in progress
+        std::atomic_thread_fence(std::memory_order_release);
+        for(i = 0; i < NB_WORDS; i++)
+            m_nData[i].store(nWords[i], std::memory_order_relaxed);
+        m_nSeq.store(nSeq + 2, std::memory_order_release);
+    }
+
+    void read(T &data) const
+    {
+        unsigned long long nWords[NB_WORDS];
+        unsigned int nSeq1, nSeq2;
+        int i;
+
+        do {
+            nSeq1 = m_nSeq.load(std::memory_order_acquire);
+            for(i = 0; i < NB_WORDS; i++)
+                nWords[i] = m_nData[i].load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            nSeq2 = m_nSeq.load(std::memory_order_relaxed);
+        } while((nSeq1 & 1) || nSeq1 != nSeq2);
+
+        memcpy(&data, nWords, sizeof(T));
+    }
+
+protected:
+    enum { NB_WORDS = (sizeof(T) + sizeof(unsigned long long) - 1) / sizeof(unsigned long long) };
+
+    std::atomic<unsigned int>           m_nSeq;
+    std::atomic<unsigned long long>     m_nData[NB_WORDS];
+};
+
+#endif
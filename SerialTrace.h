@@ -0,0 +1,155 @@
+//
+//  SerialTrace.h
+//
+//  Binary capture of the serial traffic with the DDW controller.
+//  The file is append only. It starts with the "DDWTRACE" magic followed by records:
+//      u8  type        (TRACE_OPEN, TRACE_TX, TRACE_RX, TRACE_ERROR)
+//      u16 length      of the data, little endian
+//      u64 time        steady clock in microseconds, little endian
+//      data            the bytes written or read. For TRACE_OPEN, the wall clock time
+//                      in microseconds since the epoch matching the record time (u64).
+//                      For TRACE_ERROR, the error returned by readFile (u32).
+//  Records are appended to a memory buffer, a background thread writes it out every second.
+//
+
+#ifndef __SERIAL_TRACE__
+#define __SERIAL_TRACE__
+
+#include <stdio.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+#include "AsyncLogger.h"
+
+#define TRACE_MAGIC             "DDWTRACE"
+#define TRACE_MAGIC_SIZE        8
+#define TRACE_HEADER_SIZE       11
+#define TRACE_MAX_RECORD_DATA   65535
+#define TRACE_FLUSH_INTERVAL_MS 1000
+
+enum SerialTraceRecordType {TRACE_OPEN = 0, TRACE_TX, TRACE_RX, TRACE_ERROR};
+
+class CSerialTrace
+{
+public:
+    CSerialTrace() { m_pFile = NULL; m_bRunning = false; }
+    ~CSerialTrace() { close(); }
+
+    bool open(const std::string &sPath)
+    {
+        unsigned char nWallUs[8];
+        long long nWall;
+
+        close();
+        m_pFile = fopen(sPath.c_str(), "ab");
+        if(!m_pFile)
+            return false;
+        fseek(m_pFile, 0, SEEK_END);
+        if(ftell(m_pFile) == 0)
+            fwrite(TRACE_MAGIC, 1, TRACE_MAGIC_SIZE, m_pFile);
+
+        // lets the reader turn the steady clock back into wall clock time
+        nWall = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+        putLE(nWallUs, (unsigned long long)nWall, 8);
+        record(TRACE_OPEN, nWallUs, sizeof(nWallUs));
+
+        m_bRunning = true;
+        m_Writer = std::thread(&CSerialTrace::writer, this);
+        return true;
+    }
+
+    void close()
+    {
+        if(m_bRunning) {
+            {
+                std::lock_guard<std::mutex> lock(m_Mutex);
+                m_bRunning = false;
+            }
+            m_WakeUp.notify_one();
+            m_Writer.join();
+        }
+        if(m_pFile) {
+            flush();
+            fclose(m_pFile);
+            m_pFile = NULL;
+        }
+    }
+
+    inline bool isOpen() const { return m_pFile != NULL; }
+
+    void record(int nType, const void *pData, size_t nLen)
+    {
+        unsigned char header[TRACE_HEADER_SIZE];
+
+        if(!m_pFile)
+            return;
+        if(nLen > TRACE_MAX_RECORD_DATA)
+            nLen = TRACE_MAX_RECORD_DATA;
+        header[0] = (unsigned char)nType;
+        putLE(header + 1, nLen, 2);
+        putLE(header + 3, (unsigned long long)CLogClock::nowUs(), 8);
+
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Pending.insert(m_Pending.end(), header, header + TRACE_HEADER_SIZE);
+        m_Pending.insert(m_Pending.end(), (const unsigned char *)pData, (const unsigned char *)pData + nLen);
+    }
+
+    static inline void putLE(unsigned char *pOut, unsigned long long nValue, int nBytes)
+    {
+        int i;
+        for(i = 0; i < nBytes; i++)
+            pOut[i] = (unsigned char)(nValue >> (8 * i));
+    }
+
+    static inline unsigned long long getLE(const unsigned char *pIn, int nBytes)
+    {
+        unsigned long long nValue = 0;
+        int i;
+        for(i = nBytes - 1; i >= 0; i--)
+            nValue = (nValue << 8) | pIn[i];
+        return nValue;
+    }
+
+protected:
+    // write out what was recorded, the file I/O is done without holding the lock.
+    void flush()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Writing.swap(m_Pending);
+        }
+        if(m_Writing.size()) {
+            fwrite(&m_Writing[0], 1, m_Writing.size(), m_pFile);
+            fflush(m_pFile);
+            m_Writing.clear();
+        }
+    }
+
+    void writer()
+    {
+        std::unique_lock<std::mutex> lock(m_Mutex);
+
+        while(m_bRunning) {
+            m_WakeUp.wait_for(lock, std::chrono::milliseconds(TRACE_FLUSH_INTERVAL_MS));
+            lock.unlock();
+            flush();
+            lock.lock();
+        }
+    }
+
+    FILE                        *m_pFile;
+    bool                        m_bRunning;     // protected by m_Mutex
+    std::thread                 m_Writer;
+    std::mutex                  m_Mutex;
+    std::condition_variable     m_WakeUp;
+    std::vector<unsigned char>  m_Pending;
+    std::vector<unsigned char>  m_Writing;      // only used by flush()
+};
+
+#endif
@@ -55,6 +55,7 @@ class CStopWatch
 	public:
 		CStopWatch(void)	// Constructor
 			{
+			m_dLastVirtual = timeSource() ? timeSource()() : 0.0;
 			#ifdef WIN32
 			QueryPerformanceFrequency(&m_CounterFrequency);
 			QueryPerformanceCounter(&m_LastCount);
@@ -66,6 +67,10 @@ class CStopWatch
 		// Resets timer (difference) to zero
 		inline void Reset(void) 
 			{
+			if(timeSource()) {
+				m_dLastVirtual = timeSource()();
+				return;
+				}
 			#ifdef WIN32
 			QueryPerformanceCounter(&m_LastCount);
 			#else
@@ -76,6 +81,9 @@ class CStopWatch
 		// Get elapsed time in seconds
 		float GetElapsedSeconds(void)
 			{
+			if(timeSource())
+				return float(timeSource()() - m_dLastVirtual);
+
 			// Get the current count
 			#ifdef WIN32
 			LARGE_INTEGER lCurrent;
@@ -92,7 +100,17 @@ class CStopWatch
 			#endif
 			}	
 	
+		// Replace the system clock by a virtual one (seconds), for replays and simulations.
+		// Set it before creating the stopwatches, NULL goes back to the system clock.
+		typedef double (*TimeSource)(void);
+		static TimeSource &timeSource(void)
+			{
+			static TimeSource pfnTimeSource = NULL;
+			return pfnTimeSource;
+			}
+	
 	protected:
+		double m_dLastVirtual;
 	#ifdef WIN32
 		LARGE_INTEGER m_CounterFrequency;
 		LARGE_INTEGER m_LastCount;
@@ -0,0 +1,145 @@
+//
+//  StreamDecoder.h
+//
+//  Incremental decoder of what the DDW controller sends.
+//  Bytes are fed as they are read from the port and come out as typed events, whatever the
+//  read boundaries are. The one letter messages (L, R, T, O, C, S) don't need their \r, the
+//  controller doesn't always send it. Pnnnn ends with the first non digit and the INF record
+//  (V...) with its \r, or flush() when the link goes quiet.
+//  The event data (INF record, unknown message) stays valid until the next call to decode().
+//
+
+#ifndef __STREAM_DECODER__
+#define __STREAM_DECODER__
+
+#define DECODER_MAX_MESSAGE 256
+
+enum ddwEventType {DDW_EVENT_NONE = 0, DDW_EVENT_LEFT, DDW_EVENT_RIGHT, DDW_EVENT_TICK, DDW_EVENT_POSITION,
+                   DDW_EVENT_OPENING, DDW_EVENT_CLOSING, DDW_EVENT_MANUAL, DDW_EVENT_INF, DDW_EVENT_UNKNOWN};
+
+typedef struct {
+    int         nType;      // ddwEventType
+    int         nTicks;     // DDW_EVENT_POSITION
+    const char  *pszData;   // DDW_EVENT_INF, DDW_EVENT_UNKNOWN : the message, NUL terminated without the \r
+} DdwEvent;
+
+class CStreamDecoder
+{
+public:
+    CStreamDecoder() { reset(); }
+
+    inline void reset()
+    {
+        m_nState = DECODER_IDLE;
+        m_nLen = 0;
+        m_nTicks = 0;
+        m_nDigits = 0;
+    }
+
+    // the dome reports it's moving (rotation or shutter)
+    static inline bool isMotion(int nType) { return nType >= DDW_EVENT_LEFT && nType <= DDW_EVENT_MANUAL; }
+
+    // decode from pData until one event is complete. Returns the number of bytes used, event.nType
+    // is DDW_EVENT_NONE if all of them were used without completing an event.
+    unsigned int decode(const char *pData, unsigned int nLen, DdwEvent &event)
+    {
+        unsigned int i;
+        char c;
+
+        event.nType = DDW_EVENT_NONE;
+        for(i = 0; i < nLen; i++) {
+            c = pData[i];
+            switch(m_nState) {
+                case DECODER_IDLE :
+                    switch(c) {
+                        case 'L' :  return single(DDW_EVENT_LEFT, event, i);
+                        case 'R' :  return single(DDW_EVENT_RIGHT, event, i);
+                        case 'T' :  return single(DDW_EVENT_TICK, event, i);
+                        case 'O' :  return single(DDW_EVENT_OPENING, event, i);
+                        case 'C' :  return single(DDW_EVENT_CLOSING, event, i);
+                        case 'S' :  return single(DDW_EVENT_MANUAL, event, i);
+                        case 'P' :
+                            m_nState = DECODER_POSITION;
+                            m_nTicks = 0;
+                            m_nDigits = 0;
+                            break;
+                        case 0x0D :
+                        case 0x0A :
+                        case 0 :
+                            break;
+                        default :
+                            m_nState = (c == 'V') ? DECODER_INF : DECODER_UNKNOWN;
+                            m_nLen = 0;
+                            m_szMessage[m_nLen++] = c;
+                            break;
+                    }
+                    break;
+
+                case DECODER_POSITION :
+                    if(c >= '0' && c <= '9' && m_nDigits < 9) {
+                        m_nTicks = (m_nTicks * 10) + (c - '0');
+                        m_nDigits++;
+                        break;
+                    }
+                    m_nState = DECODER_IDLE;
+                    if(!m_nDigits) {
+                        m_szMessage[0] = 'P';
+                        m_szMessage[1] = 0;
+                        event.nType = DDW_EVENT_UNKNOWN;
+                        event.pszData = m_szMessage;
+                    }
+                    else {
+                        event.nType = DDW_EVENT_POSITION;
+                        event.nTicks = m_nTicks;
+                    }
+                    return i;   // this byte starts the next message
+
+                case DECODER_INF :
+                case DECODER_UNKNOWN :
+                    if(c == 0x0D || c == 0x0A || c == 0) {
+                        m_szMessage[m_nLen] = 0;
+                        event.nType = (m_nState == DECODER_INF) ? DDW_EVENT_INF : DDW_EVENT_UNKNOWN;
+                        event.pszData = m_szMessage;
+                        m_nState = DECODER_IDLE;
+                        return i + 1;
+                    }
+                    if(m_nLen < DECODER_MAX_MESSAGE)
+                        m_szMessage[m_nLen++] = c;
+                    else
+                        m_nState = DECODER_UNKNOWN; // garbage, drop it at the next \r
+                    break;
+            }
+        }
+        return nLen;
+    }
+
+    // nothing more is coming for now : a position can't get more digits, hand it out.
+    // A partial INF record or unknown message waits for the rest.
+    bool flush(DdwEvent &event)
+    {
+        event.nType = DDW_EVENT_NONE;
+        if(m_nState != DECODER_POSITION || !m_nDigits)
+            return false;
+        m_nState = DECODER_IDLE;
+        event.nType = DDW_EVENT_POSITION;
+        event.nTicks = m_nTicks;
+        return true;
+    }
+
+protected:
+    enum {DECODER_IDLE = 0, DECODER_POSITION, DECODER_INF, DECODER_UNKNOWN};
+
+    inline unsigned int single(int nType, DdwEvent &event, unsigned int i)
+    {
+        event.nType = nType;
+        return i + 1;
+    }
+
+    int     m_nState;
+    char    m_szMessage[DECODER_MAX_MESSAGE + 1];
+    int     m_nLen;
+    int     m_nTicks;
+    int     m_nDigits;
+};
+
+#endif
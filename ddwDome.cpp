@@ -13,6 +13,8 @@ CddwDome::CddwDome()
     // set some sane values
     m_pSerx = NULL;
     m_bIsConnected = false;
+    m_nResyncState = RESYNC_IDLE;
+    m_bResyncing = false;
 
     m_nNbStepPerRev = 0;
     m_dShutterBatteryVolts = 0.0;
@@ -30,14 +32,66 @@ CddwDome::CddwDome()
     m_bHasShutter = false;
     m_bShutterOpened = false;
     
-    m_bParked = true;
+    m_nParkState = PARK_UNKNOWN;
 
     memset(m_szFirmwareVersion,0,SERIAL_BUFFER_SIZE);
+    memset(m_nGinf, 0, sizeof(m_nGinf));
+    m_nGinfFields = 0;
+    memset(&m_GinfRecord, 0, sizeof(m_GinfRecord));
+    m_nShutterState = UNKNOWN;
 
     timer.Reset();
     dataReceivedTimer.Reset();
-    m_dInfRefreshInterval = 2;
+    m_dInfRefreshInterval = INF_NORMAL_INTERVAL;
+
+    m_bAsyncIO = false;
+    m_bIOThreadRunning = false;
+    m_bCmdInFlight = false;
+    m_bStopPending = false;
+    m_bHomeCheckPending = false;
+    m_bMotionAborted = false;
+    m_nStopSentUs = 0;
+    m_nStopRxBytes = 0;
+    m_dLastStopSeconds = -1.0;
+    m_nStateUpdateTimeMs = 0;
+    m_nRxTimeUs = 0;
+    m_bCoastCompensation = true;
+    m_bCoastModelChanged = false;
+    m_bCoastSample = false;
+    m_nGotoDirection = 1;
+    m_dGotoDistance = 0;
+    m_nGotoCmdAz = 0;
+    publishState();
 	
+    m_bSerialTrace = false;
+#if defined(SB_WIN_BUILD)
+    m_sTracePath = getenv("HOMEDRIVE");
+    m_sTracePath += getenv("HOMEPATH");
+    m_sTracePath += "\\X2_DDWTrace.bin";
+#elif defined(SB_LINUX_BUILD)
+    m_sTracePath = getenv("HOME");
+    m_sTracePath += "/X2_DDWTrace.bin";
+#elif defined(SB_MAC_BUILD)
+    m_sTracePath = getenv("HOME");
+    m_sTracePath += "/X2_DDWTrace.bin";
+#endif
+
+    m_nRxBytes = 0;
+    m_nInFlightType = DDW_CMD_OTHER;
+    m_nInFlightUs = 0;
+    m_nInFlightRx = 0;
+#if defined(SB_WIN_BUILD)
+    m_sStatsPath = getenv("HOMEDRIVE");
+    m_sStatsPath += getenv("HOMEPATH");
+    m_sStatsPath += "\\X2_DDWStats.txt";
+#elif defined(SB_LINUX_BUILD)
+    m_sStatsPath = getenv("HOME");
+    m_sStatsPath += "/X2_DDWStats.txt";
+#elif defined(SB_MAC_BUILD)
+    m_sStatsPath = getenv("HOME");
+    m_sStatsPath += "/X2_DDWStats.txt";
+#endif
+
 #ifdef DDW_DEBUG
 #if defined(SB_WIN_BUILD)
     m_sLogfilePath = getenv("HOMEDRIVE");
@@ -50,38 +104,25 @@ CddwDome::CddwDome()
     m_sLogfilePath = getenv("HOME");
     m_sLogfilePath += "/X2_DDWLog.txt";
 #endif
-    Logfile = fopen(m_sLogfilePath.c_str(), "w");
-#endif
-
-#if defined DDW_DEBUG && DDW_DEBUG >= 2
-    ltime = time(NULL);
-    timestamp = asctime(localtime(&ltime));
-    timestamp[strlen(timestamp) - 1] = 0;
-	fprintf(Logfile, "[%s] [CddwDome::CddwDome] Version 2019_08_26_2000.\n", timestamp);
-    fprintf(Logfile, "[%s] [CddwDome::CddwDome] Constructor Called.\n", timestamp);
-    fflush(Logfile);
 #endif
-
+    m_nLogLevel = DDW_LOG_OFF;  // the log file is only created when logging is turned on
 }
 
 CddwDome::~CddwDome()
 {
+    stopIOThread();
 
 }
 
 int CddwDome::Connect(const char *szPort, bool bHardwareFlowControl)
 {
     int nErr;
-    int nTimeout;
-    bool bComplete;
 
+    CStateLock lock(this);
     m_bIsConnected = true;
+    m_nParkState = PARK_UNKNOWN;    // whatever was done to the dome since the last connection
 #if defined DDW_DEBUG
-    ltime = time(NULL);
-    timestamp = asctime(localtime(&ltime));
-    timestamp[strlen(timestamp) - 1] = 0;
-    fprintf(Logfile, "[%s] [CddwDome::Connect] Connecting to %s with%s hardware control.\n", timestamp, szPort, bHardwareFlowControl?"":"out");
-    fflush(Logfile);
+    DDW_LOG(DDW_LOG_INFO, "[CddwDome::Connect] Connecting to %s with%s hardware control.\n", szPort, bHardwareFlowControl?"":"out");
 #endif
 
     if(bHardwareFlowControl)
@@ -96,189 +137,320 @@ int CddwDome::Connect(const char *szPort, bool bHardwareFlowControl)
 
 	m_sPort.assign(szPort);
 	m_bHardwareFlowControl = bHardwareFlowControl;
+    m_RxBuffer.clear();
+    m_Decoder.reset();
+    m_AzTracker.stop();
+    m_GinfRecord.bValid = false;   // don't use state from a previous connection
+    m_InfScheduler.reset(steadyTimeMs() / 1000.0);
+    if(m_bSerialTrace)
+        m_SerialTrace.open(m_sTracePath);
 
 #if defined DDW_DEBUG && DDW_DEBUG >= 2
-    ltime = time(NULL);
-    timestamp = asctime(localtime(&ltime));
-    timestamp[strlen(timestamp) - 1] = 0;
-    fprintf(Logfile, "[%s] [CddwDome::Connect] Connected.\n", timestamp);
-    fprintf(Logfile, "[%s] [CddwDome::Connect] Getting Firmware.\n", timestamp);
-    fflush(Logfile);
+    DDW_LOG(DDW_LOG_VERBOSE, "[CddwDome::Connect] Connected.\n");
+    DDW_LOG(DDW_LOG_VERBOSE, "[CddwDome::Connect] Getting Firmware.\n");
 #endif
 
     // if this fails we're not properly connected.
     nErr = getFirmwareVersion(m_szFirmwareVersion, SERIAL_BUFFER_SIZE);
     if(nErr) {
 #if defined DDW_DEBUG && DDW_DEBUG >= 2
-        ltime = time(NULL);
-        timestamp = asctime(localtime(&ltime));
-        timestamp[strlen(timestamp) - 1] = 0;
-        fprintf(Logfile, "[%s] [CddwDome::Connect] Error Getting Firmware.\n", timestamp);
-        fflush(Logfile);
+        DDW_LOG(DDW_LOG_VERBOSE, "[CddwDome::Connect] Error Getting Firmware.\n");
 #endif
         m_bIsConnected = false;
         m_pSerx->close();
-        m_pSleeper->sleep(int(m_dInfRefreshInterval*1000));
+        m_SerialTrace.close();
         return nErr;
     }
 
 #if defined DDW_DEBUG && DDW_DEBUG >= 2
-    ltime = time(NULL);
-    timestamp = asctime(localtime(&ltime));
-    timestamp[strlen(timestamp) - 1] = 0;
-    fprintf(Logfile, "[%s] [CddwDome::Connect] Got Firmware : %s\n", timestamp, m_szFirmwareVersion);
-    fflush(Logfile);
+    DDW_LOG(DDW_LOG_VERBOSE, "[CddwDome::Connect] Got Firmware : %s\n", m_szFirmwareVersion);
 #endif
 
-    // get current state from DDW
-    getDomeStepPerRev();
-    getDomeHomeAz();
-    getDomeAz(m_dCurrentAzPosition);
-    getShutterState();
-    getCoast();
-    getDeadZone();
+    // get current state from DDW, everything comes from the same INF record
+    nErr = getInfRecord(!m_GinfRecord.bValid);
+    if(nErr || !m_GinfRecord.bValid) {
+#if defined DDW_DEBUG && DDW_DEBUG >= 2
+        DDW_LOG(DDW_LOG_VERBOSE, "[CddwDome::Connect] Error Getting INF record : %d\n", nErr);
+#endif
+        m_bIsConnected = false;
+        m_pSerx->close();
+        m_SerialTrace.close();
+        return nErr?nErr:ERR_CMDFAILED;
+    }
     
+    if(m_bAsyncIO) {
+        nErr = startIOThread();
+        if(nErr) {
+            m_bIsConnected = false;
+            m_pSerx->close();
+            m_SerialTrace.close();
+            return nErr;
+        }
+    }
+
     // check if we're home but current Az != home Az
     if(isDomeAtHome()) {
 #if defined DDW_DEBUG && DDW_DEBUG >= 2
-        ltime = time(NULL);
-        timestamp = asctime(localtime(&ltime));
-        timestamp[strlen(timestamp) - 1] = 0;
-        fprintf(Logfile, "[%s] [CddwDome::Connect] m_dHomeAz : %3.2f\n", timestamp, m_dHomeAz);
-        fprintf(Logfile, "[%s] [CddwDome::Connect] m_dCurrentAzPosition : %3.2f\n", timestamp, m_dCurrentAzPosition);
-        fprintf(Logfile, "[%s] [CddwDome::Connect] dCoast : %3.2f\n", timestamp, m_dCoastDeg);
-        fflush(Logfile);
-#endif
-        if( m_dCurrentAzPosition  < (m_dHomeAz - m_dCoastDeg) || m_dCurrentAzPosition  > ( m_dHomeAz + m_dCoastDeg) ) {
+        DDW_LOG(DDW_LOG_VERBOSE, "[CddwDome::Connect] m_dHomeAz : %3.2f\n", m_dHomeAz);
+        DDW_LOG(DDW_LOG_VERBOSE, "[CddwDome::Connect] m_dCurrentAzPosition : %3.2f\n", m_dCurrentAzPosition);
+        DDW_LOG(DDW_LOG_VERBOSE, "[CddwDome::Connect] dCoast : %3.2f\n", m_dCoastDeg);
+#endif
+        if( m_dCurrentAzPosition  < (m_dHomeAz - m_dCoastDeg) || m_dCurrentAzPosition  > ( m_dHomeAz + m_dCoastDeg) )
+            startResync(-(m_dCoastDeg * 1.5));  // runs in the background, see isResyncComplete()
+    }
+
+    return SB_OK;
+}
+
+#pragma mark - Home sensor resync
+
+// We're on the home sensor but the azimuth doesn't agree : move dOffsetDeg off and find home again
+// so the controller resyncs its position. Advanced by isResyncComplete() or isFindHomeComplete(),
+// returns right away. The host commands that move the dome are refused until it's over.
+void CddwDome::startResync(double dOffsetDeg)
+{
 #if defined DDW_DEBUG && DDW_DEBUG >= 2
-            ltime = time(NULL);
-            timestamp = asctime(localtime(&ltime));
-            timestamp[strlen(timestamp) - 1] = 0;
-            fprintf(Logfile, "[%s] [CddwDome::Connect] neaed to resync on home sensor\n", timestamp);
-            fprintf(Logfile, "[%s] [CddwDome::Connect] goto m_dCurrentAzPosition - m_dCoastDeg*1.5 : %3.2f\n", timestamp, m_dCurrentAzPosition - (m_dCoastDeg*1.5));
-            fflush(Logfile);
-#endif
-            gotoAzimuth(m_dCurrentAzPosition - (m_dCoastDeg * 1.5));
-            nTimeout = 0;
-            bComplete = false;
-            while(!bComplete && nTimeout<5) {
-                m_pSleeper->sleep(2000);
-                nTimeout++;
-                isGoToComplete(bComplete);
+    DDW_LOG(DDW_LOG_VERBOSE, "[CddwDome::startResync] need to resync on home sensor\n");
+    DDW_LOG(DDW_LOG_VERBOSE, "[CddwDome::startResync] goto m_dCurrentAzPosition %+3.2f : %3.2f\n", dOffsetDeg, m_dCurrentAzPosition + dOffsetDeg);
+#endif
+    m_nResyncState = RESYNC_MOVING_OFF;
+    m_ResyncTimer.Reset();
+    gotoAzimuth(m_dCurrentAzPosition + dOffsetDeg);    // before m_bResyncing is set, it would be refused
+    m_bResyncing = true;
+    m_bCoastSample = false; // the az isn't right during a resync
+}
+
+// one non blocking step of the resync, called with m_StateMutex held.
+void CddwDome::advanceResync()
+{
+    int nErr;
+    bool bComplete = false;
+
+    switch(m_nResyncState) {
+        case RESYNC_MOVING_OFF :
+            isGoToComplete(bComplete);  // a move smaller than the dead zone doesn't happen, that's fine
+            if(!bComplete) {
+                if(m_ResyncTimer.GetElapsedSeconds() >= RESYNC_STEP_TIMEOUT)
+                    abortCurrentCommand();  // still moving, stop it rather than send GHOM on top. Ends the resync as failed
+                break;
             }
-            if(nTimeout == 5)
-                return ERR_CMDFAILED;
 #if defined DDW_DEBUG && DDW_DEBUG >= 2
-            ltime = time(NULL);
-            timestamp = asctime(localtime(&ltime));
-            timestamp[strlen(timestamp) - 1] = 0;
-            fprintf(Logfile, "[%s] [CddwDome::Connect] now find home sensor\n", timestamp);
-            fflush(Logfile);
+            DDW_LOG(DDW_LOG_VERBOSE, "[CddwDome::advanceResync] now find home sensor\n");
 #endif
-            goHome();
-            bComplete = false;
-            while(!bComplete && nTimeout<5) {
-                m_pSleeper->sleep(2000);
-                nTimeout++;
-                isFindHomeComplete(bComplete);
+            m_nResyncState = RESYNC_FINDING_HOME;
+            m_ResyncTimer.Reset();
+            nErr = findHome(false);
+            if(nErr)
+                endResync(RESYNC_FAILED);
+            break;
+
+        case RESYNC_FINDING_HOME :
+            if(isDomeMoving()) {
+                if(m_ResyncTimer.GetElapsedSeconds() >= RESYNC_STEP_TIMEOUT)
+                    abortCurrentCommand();  // ends the resync as failed
+                break;
             }
-            if(nTimeout == 5)
-                return ERR_CMDFAILED;
-            getDomeAz(m_dCurrentAzPosition);
-        }
+            if(isDomeAtHome()) {
+                getDomeAz(m_dCurrentAzPosition);
+                endResync(RESYNC_DONE);
+            }
+            else
+                endResync(RESYNC_FAILED);   // not moving and not at home
+            break;
+
+        default :
+            break;
     }
+}
 
-    return SB_OK;
+void CddwDome::endResync(int nState)
+{
+#if defined DDW_DEBUG
+    DDW_LOG(DDW_LOG_INFO, "[CddwDome::endResync] home sensor resync %s\n", nState == RESYNC_DONE ? "done" : "failed");
+#endif
+    m_nResyncState = nState;
+    m_bResyncing = false;
 }
 
+int CddwDome::isResyncComplete(bool &bComplete)
+{
+    CStateLock lock(this);
+
+    if(!m_bIsConnected)
+        return NOT_CONNECTED;
 
+    if(m_bResyncing && !m_bIOThreadRunning) // the I/O thread advances it by itself
+        advanceResync();
+
+    bComplete = !m_bResyncing;
+    return m_nResyncState == RESYNC_FAILED ? ERR_CMDFAILED : DDW_OK;
+}
+
+
+// doesn't wait for the sequence in progress (Connect, a command retrying, ...) to run its course,
+// it's cancelled and we get the port within CANCEL_CHECK_MS.
 void CddwDome::Disconnect()
 {
+    CCancelRequest cancel(m_Cancel);
+
+    stopIOThread();
+    std::lock_guard<std::recursive_mutex> lock(m_StateMutex);
+    m_bResyncing = false;
+    m_nResyncState = RESYNC_IDLE;
+    m_bStopPending = false;
+    m_bHomeCheckPending = false;
     if(m_bIsConnected) {
         m_pSerx->purgeTxRx();
         m_pSerx->close();
     }
+    m_SerialTrace.close();
     m_bIsConnected = false;
+    publishState();
 }
 
 #pragma mark - DDW copmunications
 
-int CddwDome::domeCommand(const char *cmd, char *result, unsigned int resultMaxLen, unsigned int nTimeout)
+// Nothing is purged before the command : what the controller sent since we last looked (motion
+// reports, the final INF record, a late response) is decoded first so no update is lost.
+int CddwDome::domeCommand(const char *cmd, int *pnResponse, unsigned int nTimeout)
 {
     int nErr = DDW_OK;
-    char szResp[SERIAL_BUFFER_SIZE];
+    int nResponse = DDW_EVENT_NONE;
     unsigned long  nBytesWrite;
     int nNbTimeout = 0;
     int nMaxNbTimeout = 3;
+    int nCmdType = CCmdStats::cmdType(cmd);
+    long long nStartUs = steadyTimeUs();
+    long long nStepUs;
+    unsigned long nRxBytes;
+    bool bSlept;
+
+    if(m_Cancel.isCancelled())  // abort or disconnect waiting for the port
+        return ERR_ABORTEDPROCESS;
 
     do {
-        m_pSerx->purgeTxRx();
+        nErr = drainRx();
+        if(nErr) {
+            m_CmdStats.recordCommand(nCmdType, steadyTimeUs() - nStartUs, true);
+            return nErr;
+        }
     #if defined DDW_DEBUG
-        ltime = time(NULL);
-        timestamp = asctime(localtime(&ltime));
-        timestamp[strlen(timestamp) - 1] = 0;
-        fprintf(Logfile, "[%s] [CddwDome::domeCommand] Sending :'%s'\n", timestamp, cmd);
-        fflush(Logfile);
+        DDW_LOG(DDW_LOG_INFO, "[CddwDome::domeCommand] Sending :'%s'\n", cmd);
     #endif
 
-        nErr = m_pSerx->writeFile((void *)cmd, strlen(cmd), nBytesWrite);
-        m_pSerx->flushTx();
-        if(nErr)
+        nStepUs = steadyTimeUs();
+        nErr = writeCommand(cmd, nBytesWrite);
+        if(nErr) {
+            m_CmdStats.recordCommand(nCmdType, steadyTimeUs() - nStartUs, true);
             return nErr;
+        }
+        m_CmdStats.recordWrite(nCmdType, steadyTimeUs() - nStepUs, nBytesWrite);
         // read response
     #if defined DDW_DEBUG && DDW_DEBUG >= 2
-        ltime = time(NULL);
-        timestamp = asctime(localtime(&ltime));
-        timestamp[strlen(timestamp) - 1] = 0;
-        fprintf(Logfile, "[%s] [CddwDome::domeCommand] Getting response.\n", timestamp);
-        fflush(Logfile);
+        DDW_LOG(DDW_LOG_VERBOSE, "[CddwDome::domeCommand] Getting response.\n");
     #endif
-        nErr = readResponse(szResp, SERIAL_BUFFER_SIZE, nTimeout);
+        nStepUs = steadyTimeUs();
+        nRxBytes = m_nRxBytes;
+        nErr = readResponse(nResponse, nTimeout);
         if (nErr == DDW_TIMEOUT) {
-            if(nNbTimeout >= nMaxNbTimeout) // make sure we don't end up in an infinite loop
-                return ERR_NORESPONSE;
+            m_CmdStats.recordTimeout(nCmdType, m_nRxBytes - nRxBytes);
+            if(nNbTimeout >= nMaxNbTimeout || m_Cancel.isCancelled()) { // make sure we don't end up in an infinite loop
+                m_CmdStats.recordCommand(nCmdType, steadyTimeUs() - nStartUs, true);
+                return m_Cancel.isCancelled() ? ERR_ABORTEDPROCESS : ERR_NORESPONSE;
+            }
             nNbTimeout++;
-            m_pSleeper->sleep(1500);    // wait 1.5 second and resend command
+            nStepUs = steadyTimeUs();
+            bSlept = m_Cancel.sleep(m_pSleeper, 1500);    // wait 1.5 second and resend command
+            m_CmdStats.recordRetry(nCmdType, steadyTimeUs() - nStepUs);
+            if(!bSlept) {
+                m_CmdStats.recordCommand(nCmdType, steadyTimeUs() - nStartUs, true);
+                return ERR_ABORTEDPROCESS;
+            }
         }
+        else
+            m_CmdStats.recordResponse(nCmdType, steadyTimeUs() - nStepUs, m_nRxBytes - nRxBytes);
     } while (nErr == DDW_TIMEOUT);
+    m_CmdStats.recordCommand(nCmdType, steadyTimeUs() - nStartUs, nErr != DDW_OK);
+    if(nCmdType != DDW_CMD_GINF)
+        m_InfScheduler.activity(steadyTimeMs() / 1000.0);
 	
 #if defined DDW_DEBUG
-	ltime = time(NULL);
-	timestamp = asctime(localtime(&ltime));
-	timestamp[strlen(timestamp) - 1] = 0;
-    fprintf(Logfile, "[%s] [CddwDome::domeCommand] Response : '%s'\n", timestamp, szResp);
-	fflush(Logfile);
+    DDW_LOG(DDW_LOG_INFO, "[CddwDome::domeCommand] Response : %d\n", nResponse);
 #endif
 	
-    if(result)
-        strncpy(result, szResp, resultMaxLen);
+    if(pnResponse)
+        *pnResponse = nResponse;
 
     return nErr;
 
 }
 
-int CddwDome::readResponse(char *respBuffer, unsigned int bufferLen, unsigned int nTimeout)
+// send a command that starts a movement. The controller answers with a motion report, or with its
+// INF record when there is nothing to do, and handleEvent() already updated the state from it.
+// In async mode it's queued for the I/O thread.
+int CddwDome::motionCommand(const char *szCmd, unsigned int nTimeout)
 {
     int nErr = DDW_OK;
-    unsigned long nBytesRead = 0;
-    unsigned long totalBytesRead = 0;
-    char *bufPtr;
+    int nResponse;
 
-    memset(respBuffer, 0, (size_t) bufferLen);
-    bufPtr = respBuffer;
+    if(m_bIOThreadRunning) {
+        // the I/O thread will clear m_bDomeIsMoving when the controller sends the INF record
+        m_bDomeIsMoving = true;
+        dataReceivedTimer.Reset();
+        return postCommand(szCmd);
+    }
 
-    do {
-        nErr = m_pSerx->readFile(bufPtr, 1, nBytesRead, nTimeout);
+    m_bDomeIsMoving = false;    // let's not assume it's moving
+    nErr = domeCommand(szCmd, &nResponse, nTimeout);
+    if(nErr)
+        return nErr;
+
+    if(nResponse != DDW_EVENT_INF && !CStreamDecoder::isMotion(nResponse)) {
+#if defined DDW_DEBUG
+        DDW_LOG(DDW_LOG_INFO, "[CddwDome::motionCommand] unexpected response to %s\n", szCmd);
+#endif
+        return DDW_BAD_CMD_RESPONSE;
+    }
+    return nErr;
+}
+
+// read whatever the port has into m_RxBuffer.
+// If nothing is waiting we block up to nTimeout for the first byte, then get the rest in one read.
+int CddwDome::fillRxBuffer(unsigned int nTimeout)
+{
+    int nErr = DDW_OK;
+    int nbByteWaiting = 0;
+    unsigned long nBytesRead = 0;
+    unsigned long nBytesToRead;
+    unsigned int nFree;
+    char *pWritePtr;
+    int nPass;
+
+    for(nPass = 0; nPass < 2; nPass++) {
+        pWritePtr = m_RxBuffer.writePtr(nFree);
+        nbByteWaiting = 0;
+        m_pSerx->bytesWaitingRx(nbByteWaiting);
+        if(nbByteWaiting > 0)
+            nBytesToRead = (unsigned long)nbByteWaiting < nFree ? nbByteWaiting : nFree;
+        else if(nPass == 0)
+            nBytesToRead = 1;   // wait for the response to start
+        else
+            break;
+
+        nErr = m_pSerx->readFile(pWritePtr, nBytesToRead, nBytesRead, nTimeout);
         if(nErr) {
+            if(m_SerialTrace.isOpen()) {
+                unsigned char nErrCode[4];
+                CSerialTrace::putLE(nErrCode, (unsigned int)nErr, 4);
+                m_SerialTrace.record(TRACE_ERROR, nErrCode, sizeof(nErrCode));
+            }
 #if defined DDW_DEBUG && DDW_DEBUG >= 2
-            ltime = time(NULL);
-            timestamp = asctime(localtime(&ltime));
-            timestamp[strlen(timestamp) - 1] = 0;
-            fprintf(Logfile, "[%s] [CddwDome::readResponse] readFile error : %d\n", timestamp, nErr);
-            fflush(Logfile);
+            DDW_LOG(DDW_LOG_VERBOSE, "[CddwDome::fillRxBuffer] readFile error : %d\n", nErr);
 #endif
 			if(nErr == EIO || nErr == EAGAIN) {	//let's try to reconnect
 				m_pSerx->close();
+				m_RxBuffer.clear();
+				m_Decoder.reset();
 				if(m_bHardwareFlowControl)
 					nErr = m_pSerx->open(m_sPort.c_str(), 9600, SerXInterface::B_NOPARITY, "-DTR_CONTROL 1 -RTS_CONTROL 1");
 				else
@@ -287,113 +459,350 @@ int CddwDome::readResponse(char *respBuffer, unsigned int bufferLen, unsigned in
 			return nErr;
         }
 
-        if (nBytesRead !=1) {// timeout
-#if defined DDW_DEBUG && DDW_DEBUG >= 2
-            ltime = time(NULL);
-            timestamp = asctime(localtime(&ltime));
-            timestamp[strlen(timestamp) - 1] = 0;
-            fprintf(Logfile, "[%s] [CddwDome::readResponse] readFile Timeout\n", timestamp);
-            fflush(Logfile);
-#endif
-            if(totalBytesRead)    // some reponse do not end with \r\r
-                nErr = DDW_OK;
-            else
-                nErr = DDW_TIMEOUT; // no response at all, we'll need to retry
-
-            return nErr;
+        if(!nBytesRead) {
+            if(nPass == 0)
+                return DDW_TIMEOUT;
             break;
         }
-        totalBytesRead += nBytesRead;
+
+        m_SerialTrace.record(TRACE_RX, pWritePtr, nBytesRead);
+        m_RxBuffer.commit((unsigned int)nBytesRead);
+        m_nRxTimeUs = steadyTimeUs();
+        m_nRxBytes += nBytesRead;
 #if defined DDW_DEBUG && DDW_DEBUG >= 3
-        ltime = time(NULL);
-        timestamp = asctime(localtime(&ltime));
-        timestamp[strlen(timestamp) - 1] = 0;
-        fprintf(Logfile, "[%s] [CddwDome::readResponse] totalBytesRead = %lu\n", timestamp, totalBytesRead);
-        fprintf(Logfile, "[%s] [CddwDome::readResponse] respBuffer = '%s'\n", timestamp, respBuffer);
-        fflush(Logfile);
+        DDW_LOG(DDW_LOG_VERBOSE, "[CddwDome::fillRxBuffer] nBytesRead = %lu, buffered = %u\n", nBytesRead, m_RxBuffer.size());
 #endif
-    } while (*bufPtr++ != 0x0D && totalBytesRead < bufferLen );
+        if((unsigned long)nbByteWaiting > nBytesRead)   // buffer was full, let the caller consume some
+            break;
+    }
 
+    return DDW_OK;
+}
 
-    if(totalBytesRead && (*(bufPtr-1) == 0x0D))
-        *(bufPtr-1) = 0; //remove the \r
+// nTimeout is how long we wait for more data, in CANCEL_CHECK_MS slices so a cancel isn't kept waiting.
+// The first message is the response, what follows it stays in m_RxBuffer for the next decode.
+int CddwDome::readResponse(int &nResponse, unsigned int nTimeout)
+{
+    int nErr = DDW_OK;
+    DdwEvent event;
+    long long nDeadlineMs = steadyTimeMs() + nTimeout;
+    long long nRemainingMs;
+
+    nResponse = DDW_EVENT_NONE;
+    do {
+        if(nextEvent(event)) {
+            nResponse = handleEvent(event);
+            return DDW_OK;
+        }
+
+        nRemainingMs = nDeadlineMs - steadyTimeMs();
+        if(nRemainingMs > CANCEL_CHECK_MS)
+            nRemainingMs = CANCEL_CHECK_MS;
+        nErr = fillRxBuffer(nRemainingMs > 0 ? (unsigned int)nRemainingMs : 0);
+        if(!nErr)
+            nDeadlineMs = steadyTimeMs() + nTimeout;
+        else if(nErr == DDW_TIMEOUT && !m_Cancel.isCancelled() && steadyTimeMs() < nDeadlineMs)
+            nErr = DDW_OK;
+    } while(!nErr);
+
+    if(nErr == DDW_TIMEOUT && m_Decoder.flush(event)) {    // a position without anything after it
+        nResponse = handleEvent(event);
+        return DDW_OK;
+    }
+#if defined DDW_DEBUG && DDW_DEBUG >= 2
+    if(nErr == DDW_TIMEOUT)
+        DDW_LOG(DDW_LOG_VERBOSE, "[CddwDome::readResponse] readFile Timeout\n");
+#endif
 
     return nErr;
 }
 
-// read all the response, only keep the last one.
-int CddwDome::readAllResponses(char *respBuffer, unsigned int bufferLen)
+// read everything already waiting at the port and decode it.
+int CddwDome::drainRx()
 {
     int nErr = DDW_OK;
     int nbByteWaiting = 0;
 
-	memset(respBuffer, 0, bufferLen);
-    do {
+    m_pSerx->bytesWaitingRx(nbByteWaiting);
+    while(nbByteWaiting > 0) {
+        nErr = fillRxBuffer(250);
+        if(nErr)
+            break;
+        dispatchEvents(false);
+        nbByteWaiting = 0;
         m_pSerx->bytesWaitingRx(nbByteWaiting);
-		if(nbByteWaiting)
-            nErr = readResponse(respBuffer, bufferLen, 250);
-    } while(nbByteWaiting);
+    }
+    dispatchEvents(false);  // left over from a previous response
 
-    return nErr;
+    return nErr == DDW_TIMEOUT ? DDW_OK : nErr;
 }
 
+// decode the next complete message from m_RxBuffer.
+bool CddwDome::nextEvent(DdwEvent &event)
+{
+    const char *pData;
+    unsigned int nLen;
+
+    pData = m_RxBuffer.data(nLen);
+    while(nLen) {
+        unsigned int nUsed = m_Decoder.decode(pData, nLen, event);
+        m_RxBuffer.consume(nUsed);
+        if(event.nType != DDW_EVENT_NONE)
+            return true;
+        pData += nUsed;
+        nLen -= nUsed;
+    }
+    event.nType = DDW_EVENT_NONE;
+    return false;
+}
 
-int CddwDome::getInfRecord()
+// decode all of m_RxBuffer and update the dome state from each message, called with m_StateMutex held.
+// bFlush : the link went quiet, a position at the end of the data is complete.
+void CddwDome::dispatchEvents(bool bFlush)
+{
+    DdwEvent event;
+
+    while(nextEvent(event))
+        handleEvent(event);
+    if(bFlush && m_Decoder.flush(event))
+        handleEvent(event);
+}
+
+
+// the only place we write to the port, m_TxMutex lets abortCurrentCommand send a STOP from another thread.
+int CddwDome::writeCommand(const char *szCmd, unsigned long &nBytesWrite)
+{
+    int nErr;
+    std::lock_guard<std::mutex> lock(m_TxMutex);
+
+    nBytesWrite = 0;
+    nErr = m_pSerx->writeFile((void *)szCmd, strlen(szCmd), nBytesWrite);
+    m_pSerx->flushTx();
+    if(!nErr)
+        m_SerialTrace.record(TRACE_TX, szCmd, nBytesWrite);
+    return nErr;
+}
+
+int CddwDome::getInfRecord(bool bForce)
 {
     int nErr= DDW_OK;
-    char szResp[SERIAL_BUFFER_SIZE];
+    int nResponse;
     
-    if(timer.GetElapsedSeconds() < m_dInfRefreshInterval)
+    if(m_bIOThreadRunning)  // the I/O thread keeps the INF record up to date
+        return nErr;
+
+    if(!bForce && timer.GetElapsedSeconds() < m_dInfRefreshInterval)
         return nErr;
 
 #if defined DDW_DEBUG
-	ltime = time(NULL);
-	timestamp = asctime(localtime(&ltime));
-	timestamp[strlen(timestamp) - 1] = 0;
-	fprintf(Logfile, "[%s] [CddwDome::getInfRecord] *********************** \n", timestamp);
-	fflush(Logfile);
+	DDW_LOG(DDW_LOG_INFO, "[CddwDome::getInfRecord] *********************** \n");
 #endif
 
     if(m_bDomeIsMoving) {
 #if defined DDW_DEBUG && DDW_DEBUG >= 2
-        ltime = time(NULL);
-        timestamp = asctime(localtime(&ltime));
-        timestamp[strlen(timestamp) - 1] = 0;
-		fprintf(Logfile, "[%s] [CddwDome::getInfRecord] Movement in progress m_bDomeIsMoving = %s\n", timestamp, m_bDomeIsMoving?"True":"False");
-        fflush(Logfile);
+		DDW_LOG(DDW_LOG_VERBOSE, "[CddwDome::getInfRecord] Movement in progress m_bDomeIsMoving = %s\n", m_bDomeIsMoving?"True":"False");
 #endif
         return ERR_COMMANDINPROGRESS;
     }
     
     
 #if defined DDW_DEBUG && DDW_DEBUG >= 2
-    ltime = time(NULL);
-    timestamp = asctime(localtime(&ltime));
-    timestamp[strlen(timestamp) - 1] = 0;
-    fprintf(Logfile, "[%s] [CddwDome::getInfRecord] Asking for INF record\n", timestamp);
-    fflush(Logfile);
+    DDW_LOG(DDW_LOG_VERBOSE, "[CddwDome::getInfRecord] Asking for INF record\n");
 #endif
     
-    nErr = domeCommand("GINF", szResp, SERIAL_BUFFER_SIZE);
-    if(nErr) {
-        timer.Reset();
-        return nErr;
-    }
-#if defined DDW_DEBUG && DDW_DEBUG >= 2
-    ltime = time(NULL);
-    timestamp = asctime(localtime(&ltime));
-    timestamp[strlen(timestamp) - 1] = 0;
-    fprintf(Logfile, "[%s] [CddwDome::getInfRecord] got INF record : %s \n", timestamp, szResp);
-    fflush(Logfile);
-#endif
-    // parse INF packet
-    if(strlen(szResp))  // no error, let's look at the response
-        parseGINF(szResp);
-    
+    // the record is parsed by handleEvent() like any other
+    nErr = domeCommand("GINF", &nResponse);
     timer.Reset();
+#if defined DDW_DEBUG && DDW_DEBUG >= 2
+    if(!nErr && nResponse != DDW_EVENT_INF)
+        DDW_LOG(DDW_LOG_VERBOSE, "[CddwDome::getInfRecord] no INF record in the response : %d\n", nResponse);
+#endif
     return nErr;
 }
 
+#pragma mark - Background I/O
+
+void CddwDome::setAsyncIO(bool bEnable)
+{
+    // only takes effect on the next Connect
+    m_bAsyncIO = bEnable;
+}
+
+int CddwDome::startIOThread()
+{
+    if(m_bIOThreadRunning)
+        return DDW_OK;
+
+    m_CmdQueue.clear();
+    m_bCmdInFlight = false;
+    m_bIOThreadRunning = true;
+    try {
+        m_IOThread = std::thread(&CddwDome::ioThread, this);
+    } catch(const std::exception& e) {
+#if defined DDW_DEBUG
+        DDW_LOG(DDW_LOG_INFO, "[CddwDome::startIOThread] can't start I/O thread : %s\n", e.what());
+#endif
+        m_bIOThreadRunning = false;
+        return ERR_CMDFAILED;
+    }
+    return DDW_OK;
+}
+
+void CddwDome::stopIOThread()
+{
+    m_bIOThreadRunning = false;
+    if(m_IOThread.joinable())
+        m_IOThread.join();
+}
+
+// queue a command for the I/O thread, see CCmdQueue for the priorities.
+int CddwDome::postCommand(const char *szCmd, int nPriority, long long nDeadlineMs)
+{
+    if(!m_bIOThreadRunning)
+        return NOT_CONNECTED;
+
+    std::lock_guard<std::recursive_mutex> lock(m_StateMutex);
+    if(!m_CmdQueue.push(szCmd, nPriority, nDeadlineMs)) {
+#if defined DDW_DEBUG && DDW_DEBUG >= 2
+        DDW_LOG(DDW_LOG_VERBOSE, "[CddwDome::postCommand] %s already queued\n", szCmd);
+#endif
+    }
+    return DDW_OK;
+}
+
+// The I/O thread owns the serial port in async mode.
+// It sends the queued commands one at a time, polls GINF when the dome is idle and
+// decodes everything the controller sends. Dome state is only touched with m_StateMutex held,
+// never while waiting on the port.
+void CddwDome::ioThread()
+{
+    int nErr;
+    unsigned long nBytesWrite;
+    std::string sCmd;
+    long long nStartUs;
+
+    while(m_bIOThreadRunning) {
+        sCmd.clear();
+        {
+            std::lock_guard<std::recursive_mutex> lock(m_StateMutex);
+            if(m_bCmdInFlight && m_CmdTimer.GetElapsedSeconds() * 1000.0f > MAX_TIMEOUT) {
+                m_bCmdInFlight = false; // no response, give up on this one
+                m_CmdStats.recordTimeout(m_nInFlightType, m_nRxBytes - m_nInFlightRx);
+                m_CmdStats.recordCommand(m_nInFlightType, steadyTimeUs() - m_nInFlightUs, true);
+            }
+            if(!m_bDomeIsMoving && timer.GetElapsedSeconds() >= m_dInfRefreshInterval)
+                m_CmdQueue.push("GINF", CMD_PRIO_STATUS, steadyTimeMs() + (long long)(m_dInfRefreshInterval * 1000.0f));
+            else if(m_bDomeIsMoving && dataReceivedTimer.GetElapsedSeconds() >= 30.0f)
+                m_CmdQueue.push("GINF", CMD_PRIO_STATUS);  // we might have missed the final INF record
+            if(!m_bCmdInFlight) {
+                if(m_CmdQueue.pop(sCmd, steadyTimeMs()) && sCmd != "GINF")
+                    m_InfScheduler.activity(steadyTimeMs() / 1000.0);
+            }
+        }
+
+        if(sCmd.size()) {
+            nStartUs = steadyTimeUs();
+            nErr = writeCommand(sCmd.c_str(), nBytesWrite);
+            std::lock_guard<std::recursive_mutex> lock(m_StateMutex);
+            m_nInFlightType = CCmdStats::cmdType(sCmd.c_str());
+            if(!nErr) {
+                m_bCmdInFlight = true;
+                m_CmdTimer.Reset();
+                m_nInFlightUs = steadyTimeUs();
+                m_nInFlightRx = m_nRxBytes;
+                m_CmdStats.recordWrite(m_nInFlightType, m_nInFlightUs - nStartUs, nBytesWrite);
+            }
+            else
+                m_CmdStats.recordCommand(m_nInFlightType, steadyTimeUs() - nStartUs, true);
+            if(sCmd == "GINF") {
+                timer.Reset();
+                dataReceivedTimer.Reset();
+            }
+        }
+
+        nErr = fillRxBuffer(IO_THREAD_POLL_MS);
+
+        CStateLock lock(this);  // publishes what we just decoded
+        dispatchEvents(nErr == DDW_TIMEOUT);
+        if(m_bResyncing)
+            advanceResync();
+    }
+}
+
+// the I/O thread got a message, it's the response to the command in flight if there's one.
+void CddwDome::commandAnswered()
+{
+    long long nUs;
+
+    if(!m_bCmdInFlight)
+        return;
+    m_bCmdInFlight = false;
+    nUs = steadyTimeUs() - m_nInFlightUs;
+    m_CmdStats.recordResponse(m_nInFlightType, nUs, m_nRxBytes - m_nInFlightRx);
+    m_CmdStats.recordCommand(m_nInFlightType, nUs, false);
+}
+
+// update the dome state from a controller message, the only place they are interpreted.
+// Called with m_StateMutex held. Returns the event type, DDW_EVENT_UNKNOWN for a bad INF record.
+int CddwDome::handleEvent(const DdwEvent &event)
+{
+    int nType = event.nType;
+    double dRxTime = m_nRxTimeUs / 1000000.0;
+    double dAz;
+
+    dataReceivedTimer.Reset();
+    switch(event.nType) {
+        case DDW_EVENT_INF:         // getting INF = we're done with the current opperation
+            timer.Reset();
+            if(parseGINF(event.pszData)) {
+#if defined DDW_DEBUG
+                DDW_LOG(DDW_LOG_INFO, "[CddwDome::handleEvent] bad INF record : %s\n", event.pszData);
+#endif
+                nType = DDW_EVENT_UNKNOWN;
+                break;
+            }
+            m_bDomeIsMoving = false;
+            m_AzTracker.stop();
+            motionStopped(true);
+            break;
+        case DDW_EVENT_POSITION:    // moving and reporting position
+            if(m_nNbStepPerRev) {
+                m_dCurrentAzPosition = (360.0/m_nNbStepPerRev) * event.nTicks;
+                m_AzTracker.position(m_dCurrentAzPosition, dRxTime);
+            }
+            m_bDomeIsMoving = true;
+            break;
+        case DDW_EVENT_LEFT:
+        case DDW_EVENT_RIGHT:
+            m_AzTracker.start(m_dCurrentAzPosition, event.nType == DDW_EVENT_RIGHT ? 1 : -1, dRxTime);
+            m_bDomeIsMoving = true;
+            break;
+        case DDW_EVENT_TICK:        // one tick in the direction we're going
+            if(m_AzTracker.tick(dRxTime, dAz))
+                m_dCurrentAzPosition = dAz;
+            m_bDomeIsMoving = true;
+            break;
+        case DDW_EVENT_OPENING:
+        case DDW_EVENT_CLOSING:
+        case DDW_EVENT_MANUAL:
+            m_bDomeIsMoving = true;
+            break;
+        default :                   // not for us
+#if defined DDW_DEBUG && DDW_DEBUG >= 2
+            DDW_LOG(DDW_LOG_VERBOSE, "[CddwDome::handleEvent] unknown message : %s\n", event.pszData);
+#endif
+            break;
+    }
+    // the response to a goHome GHOM sent by the I/O thread : an INF record if we were already home
+    if(m_bHomeCheckPending && m_bCmdInFlight && m_nInFlightType == DDW_CMD_GHOM) {
+        m_bHomeCheckPending = false;
+        if(nType == DDW_EVENT_INF)
+            checkHomeAz();
+    }
+    commandAnswered();
+    return nType;
+}
+
 #pragma mark - Private Getters
 
 int CddwDome::getDomeAz(double &domeAz)
@@ -404,23 +813,19 @@ int CddwDome::getDomeAz(double &domeAz)
         return NOT_CONNECTED;
 
 #if defined DDW_DEBUG
-	ltime = time(NULL);
-	timestamp = asctime(localtime(&ltime));
-	timestamp[strlen(timestamp) - 1] = 0;
-	fprintf(Logfile, "[%s] [CddwDome::getDomeAz] ***********************\n", timestamp);
-	fflush(Logfile);
+	DDW_LOG(DDW_LOG_INFO, "[CddwDome::getDomeAz] ***********************\n");
 #endif
 
 
+	if(m_bDomeIsMoving && !m_bIOThreadRunning)
+        drainRx();  // catch up with the motion messages, doesn't wait
+
 	if(m_bDomeIsMoving) {
+        // interpolated from the last tick or position and the rotation speed
+        domeAz = m_AzTracker.isTracking() ? CAzTracker::estimate(m_AzTracker.track(), steadyTimeUs() / 1000000.0) : m_dCurrentAzPosition;
 #if defined DDW_DEBUG && DDW_DEBUG >= 2
-		ltime = time(NULL);
-		timestamp = asctime(localtime(&ltime));
-		timestamp[strlen(timestamp) - 1] = 0;
-        fprintf(Logfile, "[%s] [CddwDome::getDomeAz] Movement in progress m_bDomeIsMoving = %s\n", timestamp, m_bDomeIsMoving?"True":"False");
-		fflush(Logfile);
+        DDW_LOG(DDW_LOG_VERBOSE, "[CddwDome::getDomeAz] Movement in progress, domeAz = %3.2f\n", domeAz);
 #endif
-        domeAz = m_dCurrentAzPosition;  // should be updated when checking if dome is moving
         return nErr;
     }
 
@@ -428,27 +833,13 @@ int CddwDome::getDomeAz(double &domeAz)
     if(nErr)
         return nErr;
 
-    try {
-        m_nNbStepPerRev = std::stoi(m_svGinf[gDticks]);
-        m_dCurrentAzPosition = (360.0/m_nNbStepPerRev) * std::stof(m_svGinf[gADAZ]);
-    } catch(const std::exception& e) {
-#if defined DDW_DEBUG
-        ltime = time(NULL);
-        timestamp = asctime(localtime(&ltime));
-        timestamp[strlen(timestamp) - 1] = 0;
-        fprintf(Logfile, "[%s] [CddwDome::getDomeAz] std::stof or std::stoi exception : %s\n", timestamp, e.what());
-        fflush(Logfile);
-#endif
+    if(!m_GinfRecord.bValid)
         return ERR_DATAOUT;
-    }
+
     domeAz = m_dCurrentAzPosition;
 
 #if defined DDW_DEBUG && DDW_DEBUG >= 2
-    ltime = time(NULL);
-    timestamp = asctime(localtime(&ltime));
-    timestamp[strlen(timestamp) - 1] = 0;
-    fprintf(Logfile, "[%s] [CddwDome::getDomeAz] m_dCurrentAzPosition = %3.2f\n", timestamp, m_dCurrentAzPosition);
-    fflush(Logfile);
+    DDW_LOG(DDW_LOG_VERBOSE, "[CddwDome::getDomeAz] m_dCurrentAzPosition = %3.2f\n", m_dCurrentAzPosition);
 #endif
 
     return nErr;
@@ -488,39 +879,18 @@ int CddwDome::getDomeHomeAz()
         return nErr;
 
 #if defined DDW_DEBUG
-    ltime = time(NULL);
-    timestamp = asctime(localtime(&ltime));
-    timestamp[strlen(timestamp) - 1] = 0;
-    fprintf(Logfile, "[%s] [CddwDome::getDomeHomeAz] ***********************\n", timestamp);
-    fflush(Logfile);
+    DDW_LOG(DDW_LOG_INFO, "[CddwDome::getDomeHomeAz] ***********************\n");
 #endif
 
     nErr = getInfRecord();
     if(nErr)
         return nErr;
 
-    try {
-        if(!m_nNbStepPerRev)
-            m_nNbStepPerRev = std::stoi(m_svGinf[gDticks]);
-        m_dHomeAz = (360.0/m_nNbStepPerRev) * std::stof(m_svGinf[gHomeAz]);
-    } catch(const std::exception& e) {
-#if defined DDW_DEBUG
-        ltime = time(NULL);
-        timestamp = asctime(localtime(&ltime));
-        timestamp[strlen(timestamp) - 1] = 0;
-        fprintf(Logfile, "[%s] [CddwDome::getDomeHomeAz] std::stof or std::stoi exception : %s\n", timestamp, e.what());
-        fflush(Logfile);
-#endif
+    if(!m_GinfRecord.bValid)
         return ERR_DATAOUT;
-    }
-
 
 #if defined DDW_DEBUG && DDW_DEBUG >= 2
-    ltime = time(NULL);
-    timestamp = asctime(localtime(&ltime));
-    timestamp[strlen(timestamp) - 1] = 0;
-    fprintf(Logfile, "[%s] [CddwDome::getDomeHomeAz] m_dHomeAz = %3.2f\n", timestamp, m_dHomeAz);
-    fflush(Logfile);
+    DDW_LOG(DDW_LOG_VERBOSE, "[CddwDome::getDomeHomeAz] m_dHomeAz = %3.2f\n", m_dHomeAz);
 #endif
 
     return nErr;
@@ -529,7 +899,6 @@ int CddwDome::getDomeHomeAz()
 int CddwDome::getCoast()
 {
     int nErr = DDW_OK;
-    int nNbStepCoast;
     
     if(!m_bIsConnected)
         return NOT_CONNECTED;
@@ -538,39 +907,18 @@ int CddwDome::getCoast()
         return nErr;
 
 #if defined DDW_DEBUG
-    ltime = time(NULL);
-    timestamp = asctime(localtime(&ltime));
-    timestamp[strlen(timestamp) - 1] = 0;
-    fprintf(Logfile, "[%s] [CddwDome::getCoast] ***********************\n", timestamp);
-    fflush(Logfile);
+    DDW_LOG(DDW_LOG_INFO, "[CddwDome::getCoast] ***********************\n");
 #endif
 
     nErr = getInfRecord();
     if(nErr)
         return nErr;
 
-    try {
-        if(!m_nNbStepPerRev)
-            m_nNbStepPerRev = std::stoi(m_svGinf[gDticks]);
-        nNbStepCoast = std::stoi(m_svGinf[gCoast]);
-    } catch(const std::exception& e) {
-#if defined DDW_DEBUG
-        ltime = time(NULL);
-        timestamp = asctime(localtime(&ltime));
-        timestamp[strlen(timestamp) - 1] = 0;
-        fprintf(Logfile, "[%s] [CddwDome::getCoast] std::stoi exception : %s\n", timestamp, e.what());
-        fflush(Logfile);
-#endif
+    if(!m_GinfRecord.bValid)
         return ERR_DATAOUT;
-    }
-    m_dCoastDeg = (360.0/m_nNbStepPerRev) * nNbStepCoast;
 
 #if defined DDW_DEBUG && DDW_DEBUG >= 2
-    ltime = time(NULL);
-    timestamp = asctime(localtime(&ltime));
-    timestamp[strlen(timestamp) - 1] = 0;
-    fprintf(Logfile, "[%s] [CddwDome::getCoast]Coast in degrees : %3.2f\n", timestamp, m_dCoastDeg);
-    fflush(Logfile);
+    DDW_LOG(DDW_LOG_VERBOSE, "[CddwDome::getCoast]Coast in degrees : %3.2f\n", m_dCoastDeg);
 #endif
 
     return nErr;
@@ -587,36 +935,18 @@ int CddwDome::getDeadZone()
         return nErr;
 
 #if defined DDW_DEBUG
-    ltime = time(NULL);
-    timestamp = asctime(localtime(&ltime));
-    timestamp[strlen(timestamp) - 1] = 0;
-    fprintf(Logfile, "[%s] [CddwDome::getDeadZone] ***********************\n", timestamp);
-    fflush(Logfile);
+    DDW_LOG(DDW_LOG_INFO, "[CddwDome::getDeadZone] ***********************\n");
 #endif
 
     nErr = getInfRecord();
     if(nErr)
         return nErr;
     
-    try {
-        m_dDeadZoneDeg = std::stoi(m_svGinf[gINTDZ]);
-    } catch(const std::exception& e) {
-#if defined DDW_DEBUG
-        ltime = time(NULL);
-        timestamp = asctime(localtime(&ltime));
-        timestamp[strlen(timestamp) - 1] = 0;
-        fprintf(Logfile, "[%s] [CddwDome::getDeadZone] std::stoi exception : %s\n", timestamp, e.what());
-        fflush(Logfile);
-#endif
+    if(!m_GinfRecord.bValid)
         return ERR_DATAOUT;
-    }
 
 #if defined DDW_DEBUG && DDW_DEBUG >= 2
-    ltime = time(NULL);
-    timestamp = asctime(localtime(&ltime));
-    timestamp[strlen(timestamp) - 1] = 0;
-    fprintf(Logfile, "[%s] [CddwDome::getDeadZone] DeadZone in degrees : %3.2f\n", timestamp, m_dDeadZoneDeg);
-    fflush(Logfile);
+    DDW_LOG(DDW_LOG_VERBOSE, "[CddwDome::getDeadZone] DeadZone in degrees : %3.2f\n", m_dDeadZoneDeg);
 #endif
     
     return nErr;
@@ -631,62 +961,26 @@ int CddwDome::getShutterState()
         return NOT_CONNECTED;
 
 #if defined DDW_DEBUG
-	ltime = time(NULL);
-	timestamp = asctime(localtime(&ltime));
-	timestamp[strlen(timestamp) - 1] = 0;
-	fprintf(Logfile, "[%s] [CddwDome::getShutterState] ***********************\n", timestamp);
-	fflush(Logfile);
+	DDW_LOG(DDW_LOG_INFO, "[CddwDome::getShutterState] ***********************\n");
 #endif
 
 
 	if(m_bDomeIsMoving) {
 #if defined DDW_DEBUG && DDW_DEBUG >= 2
-		ltime = time(NULL);
-		timestamp = asctime(localtime(&ltime));
-		timestamp[strlen(timestamp) - 1] = 0;
-		fprintf(Logfile, "[%s] [CddwDome::getShutterState] Movement in progress m_bDomeIsMoving = %s\n", timestamp, m_bDomeIsMoving?"True":"False");
-		fflush(Logfile);
+		DDW_LOG(DDW_LOG_VERBOSE, "[CddwDome::getShutterState] Movement in progress m_bDomeIsMoving = %s\n", m_bDomeIsMoving?"True":"False");
 #endif
 		return ERR_COMMANDINPROGRESS;
 	}
 
-    m_bShutterOpened = false;
-    
 	nErr = getInfRecord();
 	if(nErr)
 		return nErr;
 
-    try {
-        m_nShutterState = std::stoi(m_svGinf[gShutter]);
-    } catch(const std::exception& e) {
-#if defined DDW_DEBUG
-        ltime = time(NULL);
-        timestamp = asctime(localtime(&ltime));
-        timestamp[strlen(timestamp) - 1] = 0;
-        fprintf(Logfile, "[%s] [CddwDome::getShutterState] std::stoi exception : %s\n", timestamp, e.what());
-        fflush(Logfile);
-#endif
+    if(!m_GinfRecord.bValid)
         return ERR_DATAOUT;
-    }
-
-    switch(m_nShutterState) {
-        case OPEN:
-            m_bShutterOpened = true;
-            break;
-
-        case CLOSED:
-		case UNKNOWN:
-		default:
-            m_bShutterOpened = false;
-            break;
-    }
 
 #if defined DDW_DEBUG && DDW_DEBUG >= 2
-	ltime = time(NULL);
-	timestamp = asctime(localtime(&ltime));
-	timestamp[strlen(timestamp) - 1] = 0;
-	fprintf(Logfile, "[%s] [CddwDome::getShutterState] shutterState = %d\n", timestamp, m_nShutterState);
-	fflush(Logfile);
+	DDW_LOG(DDW_LOG_VERBOSE, "[CddwDome::getShutterState] shutterState = %d\n", m_nShutterState);
 #endif
 
 	
@@ -702,11 +996,7 @@ int CddwDome::getDomeStepPerRev()
         return NOT_CONNECTED;
 
 #if defined DDW_DEBUG
-    ltime = time(NULL);
-    timestamp = asctime(localtime(&ltime));
-    timestamp[strlen(timestamp) - 1] = 0;
-    fprintf(Logfile, "[%s] [CddwDome::getDomeStepPerRev] ***********************\n", timestamp);
-    fflush(Logfile);
+    DDW_LOG(DDW_LOG_INFO, "[CddwDome::getDomeStepPerRev] ***********************\n");
 #endif
 
     if(!m_bDomeIsMoving)  {
@@ -715,43 +1005,27 @@ int CddwDome::getDomeStepPerRev()
             return nErr;
     }
 
-    try {
-        m_nNbStepPerRev =  std::stoi(m_svGinf[gDticks]);
-    } catch(const std::exception& e) {
-#if defined DDW_DEBUG
-        ltime = time(NULL);
-        timestamp = asctime(localtime(&ltime));
-        timestamp[strlen(timestamp) - 1] = 0;
-        fprintf(Logfile, "[%s] [CddwDome::getDomeStepPerRev] std::stoi exception : %s\n", timestamp, e.what());
-        fflush(Logfile);
-#endif
+    if(!m_GinfRecord.bValid)
         return ERR_DATAOUT;
-    }
     return nErr;
 }
 
 int CddwDome::getFirmwareVersion(char *version, int strMaxLen)
 {
+    CStateLock lock(this);
+
     int nErr = DDW_OK;
     
     if(!m_bIsConnected)
         return NOT_CONNECTED;
     
 #if defined DDW_DEBUG
-    ltime = time(NULL);
-    timestamp = asctime(localtime(&ltime));
-    timestamp[strlen(timestamp) - 1] = 0;
-    fprintf(Logfile, "[%s] [CddwDome::getFirmwareVersion] ***********************\n", timestamp);
-    fflush(Logfile);
+    DDW_LOG(DDW_LOG_INFO, "[CddwDome::getFirmwareVersion] ***********************\n");
 #endif
     
     if(strlen(m_szFirmwareVersion)){
 #if defined DDW_DEBUG && DDW_DEBUG >= 2
-        ltime = time(NULL);
-        timestamp = asctime(localtime(&ltime));
-        timestamp[strlen(timestamp) - 1] = 0;
-        fprintf(Logfile, "[%s] [CddwDome::getFirmwareVersion] m_szFirmwareVersion not empty, no need to ask again\n", timestamp);
-        fflush(Logfile);
+        DDW_LOG(DDW_LOG_VERBOSE, "[CddwDome::getFirmwareVersion] m_szFirmwareVersion not empty, no need to ask again\n");
 #endif
         strncpy(version, m_szFirmwareVersion, strMaxLen);
         return nErr;
@@ -763,37 +1037,25 @@ int CddwDome::getFirmwareVersion(char *version, int strMaxLen)
     }
     
 #if defined DDW_DEBUG && DDW_DEBUG >= 2
-    ltime = time(NULL);
-    timestamp = asctime(localtime(&ltime));
-    timestamp[strlen(timestamp) - 1] = 0;
-    fprintf(Logfile, "[%s] [CddwDome::getFirmwareVersion] calling getInfRecord();\n", timestamp);
-    fflush(Logfile);
+    DDW_LOG(DDW_LOG_VERBOSE, "[CddwDome::getFirmwareVersion] calling getInfRecord();\n");
 #endif
     
-    nErr = getInfRecord();
+    nErr = getInfRecord(!m_GinfRecord.bValid);
     if(nErr)
         return nErr;
     
 #if defined DDW_DEBUG && DDW_DEBUG >= 2
-    ltime = time(NULL);
-    timestamp = asctime(localtime(&ltime));
-    timestamp[strlen(timestamp) - 1] = 0;
-    fprintf(Logfile, "[%s] [CddwDome::getFirmwareVersion] back from getInfRecord();\n", timestamp);
-    fflush(Logfile);
+    DDW_LOG(DDW_LOG_VERBOSE, "[CddwDome::getFirmwareVersion] back from getInfRecord();\n");
 #endif
     
-    if(!m_svGinf.size())
+    if(!m_GinfRecord.bValid)
         return ERR_CMDFAILED;
     
-    strncpy(version, m_svGinf[gVersion].c_str(), strMaxLen);
+    snprintf(version, strMaxLen, "V%d", m_GinfRecord.nVersion);
     strncpy(m_szFirmwareVersion, version, SERIAL_BUFFER_SIZE);
     
 #if defined DDW_DEBUG && DDW_DEBUG >= 2
-    ltime = time(NULL);
-    timestamp = asctime(localtime(&ltime));
-    timestamp[strlen(timestamp) - 1] = 0;
-    fprintf(Logfile, "[%s] [CddwDome::getFirmwareVersion] Firmware version : %s\n", timestamp, m_szFirmwareVersion);
-    fflush(Logfile);
+    DDW_LOG(DDW_LOG_VERBOSE, "[CddwDome::getFirmwareVersion] Firmware version : %s\n", m_szFirmwareVersion);
 #endif
     
     return nErr;
@@ -804,148 +1066,60 @@ int CddwDome::getFirmwareVersion(char *version, int strMaxLen)
 
 int CddwDome::gotoAzimuth(double dNewAz)
 {
+    CStateLock lock(this);
 
     int nErr = DDW_OK;
     char buf[SERIAL_BUFFER_SIZE];
-    char szResp[SERIAL_BUFFER_SIZE];
-    int nConvErr;
-    std::vector<std::string> vFieldsData;
-    double dDomeAz;
+    double dOvershoot;
     
     if(!m_bIsConnected)
         return NOT_CONNECTED;
 
 #if defined DDW_DEBUG
-	ltime = time(NULL);
-	timestamp = asctime(localtime(&ltime));
-	timestamp[strlen(timestamp) - 1] = 0;
-	fprintf(Logfile, "[%s] [CddwDome::gotoAzimuth] ***********************\n", timestamp);
-	fflush(Logfile);
+	DDW_LOG(DDW_LOG_INFO, "[CddwDome::gotoAzimuth] ***********************\n");
 #endif
 
-	if(m_bDomeIsMoving) {
-#if defined DDW_DEBUG && DDW_DEBUG >= 2
-		ltime = time(NULL);
-		timestamp = asctime(localtime(&ltime));
-		timestamp[strlen(timestamp) - 1] = 0;
-        fprintf(Logfile, "[%s] [CddwDome::gotoAzimuth] Movement in progress m_bDomeIsMoving = %s \n", timestamp, m_bDomeIsMoving?"True":"False");
-		fflush(Logfile);
-#endif
-		return ERR_COMMANDINPROGRESS;
-	}
+	if(m_bStopPending)
+		isDomeMoving();     // the STOP confirmation may be waiting on the port
 
+	if(m_bDomeIsMoving || m_bResyncing) {
 #if defined DDW_DEBUG && DDW_DEBUG >= 2
-	ltime = time(NULL);
-	timestamp = asctime(localtime(&ltime));
-	timestamp[strlen(timestamp) - 1] = 0;
-	fprintf(Logfile, "[%s] [CddwDome::gotoAzimuth] GoTo %3.2f\n", timestamp, dNewAz);
-	fflush(Logfile);
-#endif
-
-    m_bDomeIsMoving = false;    // let's not assume it's moving
-	m_dGotoAz = dNewAz;
-    snprintf(buf, SERIAL_BUFFER_SIZE, "G%03d", int(dNewAz));
-    nErr = domeCommand(buf, szResp, SERIAL_BUFFER_SIZE);
-    if(nErr) {
-        return nErr;
-    }
-
-    if(strlen(szResp)) {  // no error, let's look at the response
-        switch(szResp[0]) {
-            case 'V':
-                parseGINF(szResp);
-                m_bDomeIsMoving = false;
-                try {
-                    m_nNbStepPerRev = std::stoi(m_svGinf[gDticks]);
-                    m_dCurrentAzPosition = (360.0/m_nNbStepPerRev) * std::stof(m_svGinf[gADAZ]);
-                } catch(const std::exception& e) {
-#if defined DDW_DEBUG
-                    ltime = time(NULL);
-                    timestamp = asctime(localtime(&ltime));
-                    timestamp[strlen(timestamp) - 1] = 0;
-                    fprintf(Logfile, "[%s] [CddwDome::gotoAzimuth] std::stof or std::stoi exception : %s\n", timestamp, e.what());
-                    fflush(Logfile);
-#endif
-                    return ERR_DATAOUT;
-                }
-
-    #if defined DDW_DEBUG && DDW_DEBUG >= 2
-                ltime = time(NULL);
-                timestamp = asctime(localtime(&ltime));
-                timestamp[strlen(timestamp) - 1] = 0;
-                fprintf(Logfile, "[%s] [CddwDome::gotoAzimuth] GINF response means the goto is too small to move the dome. So goto is done. m_bDomeIsMoving = %s\n", timestamp, m_bDomeIsMoving?"True":"False");
-                fflush(Logfile);
-    #endif
-                break;
-            case 'L':
-            case 'R':
-                m_bDomeIsMoving = true;
-                nErr = DDW_OK;
-                if(strlen(szResp)>1) {
-                    // is there a P in there too ?
-                    if(szResp[1] == 'P') {
-                        nConvErr = parseFields(szResp, vFieldsData, 'P');
-                        if(!nConvErr && m_nNbStepPerRev && vFieldsData.size()>1) {
-                            try {
-                                dDomeAz = (360.0/m_nNbStepPerRev) * std::stof(vFieldsData[1]);
-                            } catch(const std::exception& e) {
-#if defined DDW_DEBUG
-                                ltime = time(NULL);
-                                timestamp = asctime(localtime(&ltime));
-                                timestamp[strlen(timestamp) - 1] = 0;
-                                fprintf(Logfile, "[%s] [CddwDome::gotoAzimuth] std::stof exception : %s\n", timestamp, e.what());
-                                fflush(Logfile);
-#endif
-                                return ERR_DATAOUT;
-                            }
-                            if ((ceil(m_dGotoAz) <= (ceil(dDomeAz) + m_dDeadZoneDeg) ) && (ceil(m_dGotoAz) >= (ceil(dDomeAz) - m_dDeadZoneDeg) )) {
-                                m_bDomeIsMoving = false;
-                            }
-                        }
-                    }
-                }
-            case 'T':
-                m_bDomeIsMoving = true;
-                nErr = DDW_OK;
-                break;
+        DDW_LOG(DDW_LOG_VERBOSE, "[CddwDome::gotoAzimuth] Movement in progress m_bDomeIsMoving = %s, m_bResyncing = %s \n", m_bDomeIsMoving?"True":"False", m_bResyncing?"True":"False");
+#endif
+		return ERR_COMMANDINPROGRESS;
+	}
 
-            case 'P':
-                m_bDomeIsMoving = true;
-                nErr = DDW_OK;
-                nConvErr = parseFields(szResp, vFieldsData, 'P');
-                if(!nConvErr && m_nNbStepPerRev && vFieldsData.size()) {
-                    try {
-                        dDomeAz = (360.0/m_nNbStepPerRev) * std::stof(vFieldsData[0]);
-                    } catch(const std::exception& e) {
-#if defined DDW_DEBUG
-                        ltime = time(NULL);
-                        timestamp = asctime(localtime(&ltime));
-                        timestamp[strlen(timestamp) - 1] = 0;
-                        fprintf(Logfile, "[%s] [CddwDome::gotoAzimuth] std::stof exception : %s\n", timestamp, e.what());
-                        fflush(Logfile);
-#endif
-                        return ERR_DATAOUT;
-                    }
-                    if ((ceil(m_dGotoAz) <= (ceil(dDomeAz) + m_dDeadZoneDeg) ) && (ceil(m_dGotoAz) >= (ceil(dDomeAz) - m_dDeadZoneDeg) )) {
-                        m_bDomeIsMoving = false;
-                    }
-                }
-                break;
+	m_bMotionAborted = false;
 
-            default :
-                m_bDomeIsMoving = false;
-                nErr = DDW_BAD_CMD_RESPONSE;
-                break;
-        }
+#if defined DDW_DEBUG && DDW_DEBUG >= 2
+	DDW_LOG(DDW_LOG_VERBOSE, "[CddwDome::gotoAzimuth] GoTo %3.2f\n", dNewAz);
+#endif
+
+	m_dGotoAz = dNewAz;
+    m_AzTracker.setTarget(dNewAz);
+
+    // aim off by the overshoot learned for this direction and slew length
+    m_dGotoDistance = CAzTracker::delta(dNewAz - m_dCurrentAzPosition);
+    m_nGotoDirection = m_dGotoDistance >= 0 ? 1 : -1;
+    m_dGotoDistance = fabs(m_dGotoDistance);
+    m_bCoastSample = m_dGotoDistance > m_dDeadZoneDeg;
+    m_nGotoCmdAz = int(dNewAz);
+    if(m_bCoastCompensation && m_bCoastSample && m_CoastModel.predict(m_nGotoDirection, m_dGotoDistance, dOvershoot)) {
+        m_nGotoCmdAz = int(floor(CAzTracker::normalize(dNewAz - m_nGotoDirection * dOvershoot) + 0.5)) % 360;
+#if defined DDW_DEBUG && DDW_DEBUG >= 2
+        DDW_LOG(DDW_LOG_VERBOSE, "[CddwDome::gotoAzimuth] expected overshoot %3.2f, sending G%03d\n", dOvershoot, m_nGotoCmdAz);
+#endif
     }
-    dataReceivedTimer.Reset();
+
+    snprintf(buf, SERIAL_BUFFER_SIZE, "G%03d", m_nGotoCmdAz);
+    nErr = motionCommand(buf);  // an INF record as the response means the goto is too small to move the dome
+    if(nErr || !m_bDomeIsMoving)
+        m_bCoastSample = false;
+    else if(m_nParkState == PARKED)
+        m_nParkState = UNPARKED;    // slewed off the park position
 
 #if defined DDW_DEBUG && DDW_DEBUG >= 2
-    ltime = time(NULL);
-    timestamp = asctime(localtime(&ltime));
-    timestamp[strlen(timestamp) - 1] = 0;
-    fprintf(Logfile, "[%s] [CddwDome::gotoAzimuth] m_dCurrentAzPosition = %3.2f, m_bDomeIsMoving = %s\n", timestamp, m_dCurrentAzPosition, m_bDomeIsMoving?"True":"False");
-    fflush(Logfile);
+    DDW_LOG(DDW_LOG_VERBOSE, "[CddwDome::gotoAzimuth] m_dCurrentAzPosition = %3.2f, m_bDomeIsMoving = %s\n", m_dCurrentAzPosition, m_bDomeIsMoving?"True":"False");
 #endif
 
     return nErr;
@@ -953,295 +1127,157 @@ int CddwDome::gotoAzimuth(double dNewAz)
 
 int CddwDome::goHome()
 {
-    int nErr = DDW_OK;
-    char szResp[SERIAL_BUFFER_SIZE];
-    int nTmpAz;
-    int nTmphomeAz;
-    bool bAtHome;
-    bool bIsGotoDone;
-    int nTimeout;
-    int nTmp;
-    
+    CStateLock lock(this);
+
     if(!m_bIsConnected)
         return NOT_CONNECTED;
     
 #if defined DDW_DEBUG
-    ltime = time(NULL);
-    timestamp = asctime(localtime(&ltime));
-    timestamp[strlen(timestamp) - 1] = 0;
-    fprintf(Logfile, "[%s] [CddwDome::goHome] ***********************\n", timestamp);
-    fflush(Logfile);
+    DDW_LOG(DDW_LOG_INFO, "[CddwDome::goHome] ***********************\n");
 #endif
     
-    if(m_bDomeIsMoving) {
+    if(m_bStopPending)
+        isDomeMoving();     // the STOP confirmation may be waiting on the port
+
+    if(m_bDomeIsMoving || m_bResyncing) {
 #if defined DDW_DEBUG && DDW_DEBUG >= 2
-        ltime = time(NULL);
-        timestamp = asctime(localtime(&ltime));
-        timestamp[strlen(timestamp) - 1] = 0;
-        fprintf(Logfile, "[%s] [CddwDome::goHome] Movement in progress m_bDomeIsMoving = %s\n", timestamp, m_bDomeIsMoving?"True":"False");
-        fflush(Logfile);
+        DDW_LOG(DDW_LOG_VERBOSE, "[CddwDome::goHome] Movement in progress m_bDomeIsMoving = %s, m_bResyncing = %s\n", m_bDomeIsMoving?"True":"False", m_bResyncing?"True":"False");
 #endif
         return ERR_COMMANDINPROGRESS;
     }
+
+    m_bMotionAborted = false;
     
-    m_bDomeIsMoving = false;
-    nErr = domeCommand("GHOM", szResp, SERIAL_BUFFER_SIZE);
-    if(nErr) {
+    m_nResyncState = RESYNC_IDLE;   // isFindHomeComplete only reports a resync started by this goHome
+    return findHome(true);
+}
+
+// send GHOM. If we're already home but the dome az is wrong and bResync is set, start a resync
+// (move off and back home, hopping the controller will correct the position when the sensor
+// transition happens). It is advanced by isFindHomeComplete(), nothing here waits for the dome.
+// In async mode the GHOM response comes later, the I/O thread does the check when it gets it.
+int CddwDome::findHome(bool bResync)
+{
+    int nErr = DDW_OK;
+
+    m_AzTracker.clearTarget();
+    m_bCoastSample = false;
+    m_bHomeCheckPending = false;
+    nErr = motionCommand("GHOM");
+    if(nErr)
+        return nErr;
+
+    if(m_bIOThreadRunning) {
+        m_bHomeCheckPending = bResync;
         return nErr;
     }
-    
-    if(strlen(szResp)) {  // no error, let's look at the response
-        switch(szResp[0]) {
-            case 'V':
-                parseGINF(szResp);
-                try {
-                    nTmp = std::stoi(m_svGinf[gHome]);
-                } catch(const std::exception& e) {
-#if defined DDW_DEBUG
-                    ltime = time(NULL);
-                    timestamp = asctime(localtime(&ltime));
-                    timestamp[strlen(timestamp) - 1] = 0;
-                    fprintf(Logfile, "[%s] [CddwDome::goHome] std::stoi exception : %s\n", timestamp, e.what());
-                    fflush(Logfile);
-#endif
-                    return ERR_CMDFAILED;
-                }
-
-                if( nTmp == AT_HOME) {  // we're already home ?
-                    // check that the current position and the home position aggree
-                    try {
-                        nTmpAz = std::stoi(m_svGinf[gADAZ]);
-                        nTmphomeAz = std::stoi(m_svGinf[gHomeAz]);
-                    } catch(const std::exception& e) {
-#if defined DDW_DEBUG
-                        ltime = time(NULL);
-                        timestamp = asctime(localtime(&ltime));
-                        timestamp[strlen(timestamp) - 1] = 0;
-                        fprintf(Logfile, "[%s] [CddwDome::goHome] std::stof or std::stoi exception : %s\n", timestamp, e.what());
-                        fflush(Logfile);
-#endif
-                        return ERR_CMDFAILED;
-                    }
-
-                    if( nTmpAz < floor(nTmphomeAz - m_dCoastDeg) || nTmpAz > ceil(nTmphomeAz + m_dCoastDeg)) {
-                        // we're  home but the dome az is wrong, let's move off and back home, hopping the controller will correct the position
-                        // when the sensor transition happens.
-#if defined DDW_DEBUG && DDW_DEBUG >= 2
-                        ltime = time(NULL);
-                        timestamp = asctime(localtime(&ltime));
-                        timestamp[strlen(timestamp) - 1] = 0;
-                        fprintf(Logfile, "[%s] [CddwDome::goHome] not home, moving %3.2f degree off (m_dDeadZoneDeg + 1 degree)\n", timestamp, m_dDeadZoneDeg + 1.0);
-                        fflush(Logfile);
-#endif
-                        bIsGotoDone = false;
-                        nTimeout = 0;
-                        gotoAzimuth(m_dCurrentAzPosition + m_dDeadZoneDeg + 1.0); // move by INTDZ+1 degree off to make sure there is a movement
-                        do {
-                            m_pSleeper->sleep(1000);
-                            isGoToComplete(bIsGotoDone);
-                            nTimeout++;
-                        } while (!bIsGotoDone && nTimeout<60);    // 60 seconds of timeout should be enough
+
+    // an INF record as the response, are we already home ?
+    if(!m_bDomeIsMoving && bResync)
+        checkHomeAz();
+    return nErr;
+}
+
+// GHOM was answered with an INF record, we were already home. Start a resync if the
+// current position and the home position don't aggree. Called with m_StateMutex held.
+void CddwDome::checkHomeAz()
+{
+    int nTmpAz;
+    int nTmphomeAz;
+
+    if(m_GinfRecord.nHome != AT_HOME)
+        return;
+
+    nTmpAz = m_GinfRecord.nAzTicks;
+    nTmphomeAz = m_GinfRecord.nHomeTicks;
+
+    if( nTmpAz < floor(nTmphomeAz - m_dCoastDeg) || nTmpAz > ceil(nTmphomeAz + m_dCoastDeg)) {
 #if defined DDW_DEBUG && DDW_DEBUG >= 2
-                        ltime = time(NULL);
-                        timestamp = asctime(localtime(&ltime));
-                        timestamp[strlen(timestamp) - 1] = 0;
-                        fprintf(Logfile, "[%s] [CddwDome::goHome] not home, moving back home\n", timestamp);
-                        fflush(Logfile);
-#endif
-                        bAtHome = false;
-                        nTimeout = 0;
-                        nErr = domeCommand("GHOM", szResp, SERIAL_BUFFER_SIZE); // go back home
-                        do {
-                            m_pSleeper->sleep(1000);
-                            isFindHomeComplete(bAtHome);
-                            nTimeout++;
-                        } while (!bAtHome && nTimeout<60); // the timeout is just here for safety (1 minute).
-                    }
-                    m_bDomeIsMoving = false;
-                }
-                break;
-                
-            case 'L':
-            case 'R':
-            case 'T':
-                nErr = DDW_OK;
-                m_bDomeIsMoving = true;
-                break;
-                
-            case 'P':
-                nErr = DDW_OK;
-                m_bDomeIsMoving = true;
-                break;
-                
-            default :
-                nErr = DDW_BAD_CMD_RESPONSE;
-                m_bDomeIsMoving = false;
-                break;
-        }
+        DDW_LOG(DDW_LOG_VERBOSE, "[CddwDome::checkHomeAz] not home, moving %3.2f degree off (m_dDeadZoneDeg + 1 degree)\n", m_dDeadZoneDeg + 1.0);
+#endif
+        startResync(m_dDeadZoneDeg + 1.0); // move by INTDZ+1 degree off to make sure there is a movement
     }
-    dataReceivedTimer.Reset();
-    return nErr;
 }
 
 int CddwDome::openShutter()
 {
+    CStateLock lock(this);
+
     int nErr = DDW_OK;
-    char szResp[SERIAL_BUFFER_SIZE];
-	int shutterState;
-	
+
     if(!m_bIsConnected)
         return NOT_CONNECTED;
 
 #if defined DDW_DEBUG
-	ltime = time(NULL);
-	timestamp = asctime(localtime(&ltime));
-	timestamp[strlen(timestamp) - 1] = 0;
-	fprintf(Logfile, "[%s] [CddwDome::openShutter] ***********************\n", timestamp);
-	fflush(Logfile);
+	DDW_LOG(DDW_LOG_INFO, "[CddwDome::openShutter] ***********************\n");
 #endif
 
 
-	if(m_bDomeIsMoving) {
+	if(m_bStopPending)
+		isDomeMoving();     // the STOP confirmation may be waiting on the port
+
+	if(m_bDomeIsMoving || m_bResyncing) {
 #if defined DDW_DEBUG && DDW_DEBUG >= 2
-		ltime = time(NULL);
-		timestamp = asctime(localtime(&ltime));
-		timestamp[strlen(timestamp) - 1] = 0;
-        fprintf(Logfile, "[%s] [CddwDome::openShutter] Movement in progress m_bDomeIsMoving = %s\n", timestamp, m_bDomeIsMoving?"True":"False");
-		fflush(Logfile);
+        DDW_LOG(DDW_LOG_VERBOSE, "[CddwDome::openShutter] Movement in progress m_bDomeIsMoving = %s, m_bResyncing = %s\n", m_bDomeIsMoving?"True":"False", m_bResyncing?"True":"False");
 #endif
 		return ERR_COMMANDINPROGRESS;
 	}
 
+	m_bMotionAborted = false;
 
-	nErr = domeCommand("GOPN", szResp, SERIAL_BUFFER_SIZE, 10000); // 10 second timeout
-    if(nErr)
-        return nErr;
-
-	m_bDomeIsMoving = true;
-	if(strlen(szResp) && szResp[0] == 'V') {
-		//if we got an INF packet we're not moving
-		m_bDomeIsMoving = false;
-		parseGINF(szResp);
-        try {
-            shutterState = std::stoi(m_svGinf[gShutter]);
-        } catch(const std::exception& e) {
-#if defined DDW_DEBUG
-            ltime = time(NULL);
-            timestamp = asctime(localtime(&ltime));
-            timestamp[strlen(timestamp) - 1] = 0;
-            fprintf(Logfile, "[%s] [CddwDome::openShutter] std::stoi exception : %s\n", timestamp, e.what());
-            fflush(Logfile);
-#endif
-            return ERR_CMDFAILED;
-        }
-
-        switch(shutterState) {
-			case OPEN:
-				m_bShutterOpened = true;
-				break;
-				
-			case CLOSED:
-			case UNKNOWN:
-			default:
-				m_bShutterOpened = false;
-				break;
-		}
-	}
-
-    dataReceivedTimer.Reset();
+	nErr = motionCommand("GOPN", 10000); // 10 second timeout
     return nErr;
 }
 
 int CddwDome::closeShutter()
 {
+    CStateLock lock(this);
+
     int nErr = DDW_OK;
-    char szResp[SERIAL_BUFFER_SIZE];
-	int shutterState;
-	
+
     if(!m_bIsConnected)
         return NOT_CONNECTED;
 
 #if defined DDW_DEBUG
-	ltime = time(NULL);
-	timestamp = asctime(localtime(&ltime));
-	timestamp[strlen(timestamp) - 1] = 0;
-	fprintf(Logfile, "[%s] [CddwDome::closeShutter] ***********************\n", timestamp);
-	fflush(Logfile);
+	DDW_LOG(DDW_LOG_INFO, "[CddwDome::closeShutter] ***********************\n");
 #endif
 
-    if(m_bDomeIsMoving) {
+    if(m_bStopPending)
+        isDomeMoving();     // the STOP confirmation may be waiting on the port
+
+    if(m_bDomeIsMoving || m_bResyncing) {
 #if defined DDW_DEBUG && DDW_DEBUG >= 2
-        ltime = time(NULL);
-        timestamp = asctime(localtime(&ltime));
-        timestamp[strlen(timestamp) - 1] = 0;
-        fprintf(Logfile, "[%s] [CddwDome::closeShutter] Movement in progress m_bDomeIsMoving = %s\n", timestamp, m_bDomeIsMoving?"True":"False");
-        fflush(Logfile);
+        DDW_LOG(DDW_LOG_VERBOSE, "[CddwDome::closeShutter] Movement in progress m_bDomeIsMoving = %s, m_bResyncing = %s\n", m_bDomeIsMoving?"True":"False", m_bResyncing?"True":"False");
 #endif
         return ERR_COMMANDINPROGRESS;
     }
 
-	nErr = domeCommand("GCLS", szResp, SERIAL_BUFFER_SIZE, 10000); // 10 second timeout
-    if(nErr)
-        return nErr;
-
-	m_bDomeIsMoving = true;
-	if(strlen(szResp) && szResp[0] == 'V') {
-		//if we got an INF packet we're not moving
-		m_bDomeIsMoving = false;
-		parseGINF(szResp);
-        try {
-            shutterState = std::stoi(m_svGinf[gShutter]);
-        } catch(const std::exception& e) {
-#if defined DDW_DEBUG
-            ltime = time(NULL);
-            timestamp = asctime(localtime(&ltime));
-            timestamp[strlen(timestamp) - 1] = 0;
-            fprintf(Logfile, "[%s] [CddwDome::closeShutter] std::stoi exception : %s\n", timestamp, e.what());
-            fflush(Logfile);
-#endif
-            return ERR_CMDFAILED;
-        }
-
-        switch(shutterState) {
-			case OPEN:
-				m_bShutterOpened = true;
-				break;
-				
-			case CLOSED:
-			case UNKNOWN:
-			default:
-				m_bShutterOpened = false;
-				break;
-		}
-	}
+    m_bMotionAborted = false;
 
-    dataReceivedTimer.Reset();
+	nErr = motionCommand("GCLS", 10000); // 10 second timeout
     return nErr;
 }
 
 
 int CddwDome::parkDome()
 {
+    CStateLock lock(this);
+
     int nErr = DDW_OK;
     
     if(!m_bIsConnected)
         return NOT_CONNECTED;
 
 #if defined DDW_DEBUG
-	ltime = time(NULL);
-	timestamp = asctime(localtime(&ltime));
-	timestamp[strlen(timestamp) - 1] = 0;
-	fprintf(Logfile, "[%s] [CddwDome::parkDome] ***********************\n", timestamp);
-	fflush(Logfile);
+	DDW_LOG(DDW_LOG_INFO, "[CddwDome::parkDome] ***********************\n");
 #endif
 
-    if(m_bDomeIsMoving) {
+    if(m_bStopPending)
+        isDomeMoving();     // the STOP confirmation may be waiting on the port
+
+    if(m_bDomeIsMoving || m_bResyncing) {
 #if defined DDW_DEBUG && DDW_DEBUG >= 2
-        ltime = time(NULL);
-        timestamp = asctime(localtime(&ltime));
-        timestamp[strlen(timestamp) - 1] = 0;
-        fprintf(Logfile, "[%s] [CddwDome::parkDome]Movement in progress m_bDomeIsMoving = %s\n", timestamp, m_bDomeIsMoving?"True":"False");
-        fflush(Logfile);
+        DDW_LOG(DDW_LOG_VERBOSE, "[CddwDome::parkDome]Movement in progress m_bDomeIsMoving = %s, m_bResyncing = %s\n", m_bDomeIsMoving?"True":"False", m_bResyncing?"True":"False");
 #endif
         return ERR_COMMANDINPROGRESS;
     }
@@ -1252,28 +1288,22 @@ int CddwDome::parkDome()
 
 int CddwDome::unparkDome()
 {
+    CStateLock lock(this);
+
     int nErr = DDW_OK;
     
 #if defined DDW_DEBUG
-	ltime = time(NULL);
-	timestamp = asctime(localtime(&ltime));
-	timestamp[strlen(timestamp) - 1] = 0;
-	fprintf(Logfile, "[%s] [CddwDome::unparkDome] ***********************\n", timestamp);
-	fflush(Logfile);
+	DDW_LOG(DDW_LOG_INFO, "[CddwDome::unparkDome] ***********************\n");
 #endif
 
-	if(m_bDomeIsMoving) {
+	if(m_bDomeIsMoving || m_bResyncing) {
 #if defined DDW_DEBUG && DDW_DEBUG >= 2
-        ltime = time(NULL);
-        timestamp = asctime(localtime(&ltime));
-        timestamp[strlen(timestamp) - 1] = 0;
-        fprintf(Logfile, "[%s] [CddwDome::unparkDome] Movement in progress m_bDomeIsMoving = %s\n", timestamp, m_bDomeIsMoving?"True":"False");
-        fflush(Logfile);
+        DDW_LOG(DDW_LOG_VERBOSE, "[CddwDome::unparkDome] Movement in progress m_bDomeIsMoving = %s, m_bResyncing = %s\n", m_bDomeIsMoving?"True":"False", m_bResyncing?"True":"False");
 #endif
         return ERR_COMMANDINPROGRESS;
     }
 
-    m_bParked = false;
+    m_nParkState = UNPARKED;
     nErr = goHome();
     return nErr;
 }
@@ -1281,77 +1311,138 @@ int CddwDome::unparkDome()
 
 int CddwDome::calibrate()
 {
+    CStateLock lock(this);
 
     int nErr = DDW_OK;
-    char szResp[SERIAL_BUFFER_SIZE];
 
     if(!m_bIsConnected)
         return NOT_CONNECTED;
 
 #if defined DDW_DEBUG
-	ltime = time(NULL);
-	timestamp = asctime(localtime(&ltime));
-	timestamp[strlen(timestamp) - 1] = 0;
-	fprintf(Logfile, "[%s] [CddwDome::calibrate] ***********************\n", timestamp);
-	fflush(Logfile);
+	DDW_LOG(DDW_LOG_INFO, "[CddwDome::calibrate] ***********************\n");
 #endif
 
-	if(m_bDomeIsMoving) {
+	if(m_bStopPending)
+		isDomeMoving();     // the STOP confirmation may be waiting on the port
+
+	if(m_bDomeIsMoving || m_bResyncing) {
 #if defined DDW_DEBUG && DDW_DEBUG >= 2
-		ltime = time(NULL);
-		timestamp = asctime(localtime(&ltime));
-		timestamp[strlen(timestamp) - 1] = 0;
-        fprintf(Logfile, "[%s] [CddwDome::calibrate] Movement in progress m_bDomeIsMoving = %s\n", timestamp, m_bDomeIsMoving?"True":"False");
-		fflush(Logfile);
+        DDW_LOG(DDW_LOG_VERBOSE, "[CddwDome::calibrate] Movement in progress m_bDomeIsMoving = %s, m_bResyncing = %s\n", m_bDomeIsMoving?"True":"False", m_bResyncing?"True":"False");
 #endif
 		return ERR_COMMANDINPROGRESS;
 	}
 
+	m_bMotionAborted = false;
 
-	m_bDomeIsMoving = false;
-
-    nErr = domeCommand("GTRN", szResp, SERIAL_BUFFER_SIZE);
-    if(nErr)
-        return nErr;
-
-	if(strlen(szResp)) {
-		switch(szResp[0]) {
-			case 'L':
-			case 'R':
-			case 'T':
-			case 'P':
-				nErr = DDW_OK;
-				m_bDomeIsMoving = true;
-				break;
-			default :
-				nErr = DDW_BAD_CMD_RESPONSE;
-				break;
-		}
-	}
-    dataReceivedTimer.Reset();
+    m_AzTracker.clearTarget();
+    m_bCoastSample = false;
+    nErr = motionCommand("GTRN");
+    if(!nErr && !m_bDomeIsMoving)   // calibration didn't start
+        nErr = DDW_BAD_CMD_RESPONSE;
     return nErr;
 }
 
+// Emergency stop : STOP goes on the wire right away, whatever holds the state lock, without purge,
+// retries or waiting for the response (m_TxMutex only serializes it with another write).
+// The dome is still moving until the controller says otherwise, motionStopped() confirms the stop
+// from the final INF record and measures how long it took. In sync mode that record is read by
+// the next poll, so the measured time is at most one poll late.
+// A sequence in progress in another thread is cancelled and gives up within CANCEL_CHECK_MS.
 int CddwDome::abortCurrentCommand()
 {
-    int nErr;
-    
+    int nErr = DDW_OK;
+    unsigned long nBytesWrite;
+    long long nStartUs;
+    long long nSentUs;
+
     if(!m_bIsConnected)
         return NOT_CONNECTED;
-    
-    m_bDomeIsMoving = false;
-    
+
+    CCancelRequest cancel(m_Cancel);
+    nStartUs = steadyTimeUs();
+    nErr = writeCommand("STOP\n", nBytesWrite);
+    nSentUs = steadyTimeUs();
+
+    CStateLock lock(this);
+
 #if defined DDW_DEBUG
-    ltime = time(NULL);
-    timestamp = asctime(localtime(&ltime));
-    timestamp[strlen(timestamp) - 1] = 0;
-    fprintf(Logfile, "[%s] [CddwDome::abortCurrentCommand] ***********************\n", timestamp);
-    fflush(Logfile);
+    DDW_LOG(DDW_LOG_INFO, "[CddwDome::abortCurrentCommand] STOP sent in %lld us, nErr = %d\n", nSentUs - nStartUs, nErr);
+#endif
+
+    if(m_bResyncing)
+        endResync(RESYNC_FAILED);
+    m_bCoastSample = false;     // doesn't say anything about coasting
+
+    if(nErr) {
+        m_CmdStats.recordCommand(DDW_CMD_STOP, nSentUs - nStartUs, true);
+        return nErr;
+    }
+    m_CmdStats.recordWrite(DDW_CMD_STOP, nSentUs - nStartUs, nBytesWrite);
+
+    if(m_bIOThreadRunning) {
+        m_CmdQueue.cancelMotion();
+        if(m_bCmdInFlight) {
+            m_bCmdInFlight = false; // preempted by the STOP
+            m_CmdStats.recordCommand(m_nInFlightType, steadyTimeUs() - m_nInFlightUs, true);
+        }
+    }
+
+    if(!m_bDomeIsMoving) {  // nothing to confirm
+        m_CmdStats.recordCommand(DDW_CMD_STOP, nSentUs - nStartUs, false);
+        return DDW_OK;
+    }
+
+    m_bMotionAborted = true;
+    m_bStopPending = true;
+    m_nStopSentUs = nSentUs;
+    m_nStopRxBytes = m_nRxBytes;
+    dataReceivedTimer.Reset();
+    return DDW_OK;
+}
+
+// the controller sent its INF record after a STOP, called with m_StateMutex held.
+void CddwDome::motionStopped(bool bConfirmed)
+{
+    long long nUs;
+
+    if(!m_bStopPending)
+        return;
+    m_bStopPending = false;
+    nUs = steadyTimeUs() - m_nStopSentUs;
+    m_CmdStats.recordCommand(DDW_CMD_STOP, nUs, !bConfirmed);
+    if(!bConfirmed) {
+#if defined DDW_DEBUG
+        DDW_LOG(DDW_LOG_INFO, "[CddwDome::motionStopped] STOP never confirmed by the controller\n");
+#endif
+        return;
+    }
+    m_CmdStats.recordResponse(DDW_CMD_STOP, nUs, m_nRxBytes - m_nStopRxBytes);
+    m_dLastStopSeconds = nUs / 1000000.0;
+#if defined DDW_DEBUG
+    DDW_LOG(DDW_LOG_INFO, "[CddwDome::motionStopped] dome stopped %3.3f seconds after the STOP\n", m_dLastStopSeconds.load());
+#endif
+}
+
+// a goto ended at dDomeAz, learn how far past the commanded azimuth it stopped. Called with m_StateMutex held.
+void CddwDome::learnCoast(double dDomeAz)
+{
+    double dOvershoot;
+
+    if(!m_bCoastSample)
+        return;
+    m_bCoastSample = false;
+
+    dOvershoot = CAzTracker::delta(dDomeAz - m_nGotoCmdAz) * m_nGotoDirection;
+    if(!m_CoastModel.record(m_nGotoDirection, m_dGotoDistance, dOvershoot)) {
+#if defined DDW_DEBUG
+        DDW_LOG(DDW_LOG_INFO, "[CddwDome::learnCoast] overshoot %3.2f on a %3.2f degree goto ignored\n", dOvershoot, m_dGotoDistance);
+#endif
+        return;
+    }
+    m_bCoastModelChanged = true;
+#if defined DDW_DEBUG && DDW_DEBUG >= 2
+    DDW_LOG(DDW_LOG_VERBOSE, "[CddwDome::learnCoast] %s %3.2f degree goto stopped %3.2f past G%03d\n", m_nGotoDirection > 0 ? "increasing" : "decreasing", m_dGotoDistance, dOvershoot, m_nGotoCmdAz);
 #endif
-    
-    nErr = domeCommand("STOP\n", NULL, SERIAL_BUFFER_SIZE, 250);
-    
-    return nErr;
 }
 
 int CddwDome::syncDome(double dAz, double dEl)
@@ -1364,161 +1455,45 @@ int CddwDome::syncDome(double dAz, double dEl)
 bool CddwDome::isDomeMoving()
 {
     int nErr = DDW_OK;
-    int nConvErr = DDW_OK;
-    char szResp[SERIAL_BUFFER_SIZE];
-    std::vector<std::string> vFieldsData;
     
     if(!m_bIsConnected)
         return NOT_CONNECTED;
     
 #if defined DDW_DEBUG
-    ltime = time(NULL);
-    timestamp = asctime(localtime(&ltime));
-    timestamp[strlen(timestamp) - 1] = 0;
-    fprintf(Logfile, "[%s] [CddwDome::isDomeMoving] ***********************\n", timestamp);
-    fflush(Logfile);
+    DDW_LOG(DDW_LOG_INFO, "[CddwDome::isDomeMoving] ***********************\n");
 #endif
     
     if(!m_bDomeIsMoving) {
 #if defined DDW_DEBUG && DDW_DEBUG >= 2
-        ltime = time(NULL);
-        timestamp = asctime(localtime(&ltime));
-        timestamp[strlen(timestamp) - 1] = 0;
-        fprintf(Logfile, "[%s] [CddwDome::isDomeMoving] isMoving = %s, there was no movement initiated\n", timestamp, m_bDomeIsMoving?"True":"False");
-        fflush(Logfile);
+        DDW_LOG(DDW_LOG_VERBOSE, "[CddwDome::isDomeMoving] isMoving = %s, there was no movement initiated\n", m_bDomeIsMoving?"True":"False");
 #endif
         return m_bDomeIsMoving;
     }
-    
-    // read as much as we can.
-    nErr = readAllResponses(szResp, SERIAL_BUFFER_SIZE);
-    
-#if defined DDW_DEBUG && DDW_DEBUG >= 2
-    ltime = time(NULL);
-    timestamp = asctime(localtime(&ltime));
-    timestamp[strlen(timestamp) - 1] = 0;
-    fprintf(Logfile, "[%s] [CddwDome::isDomeMoving] resp = %s\n", timestamp, szResp);
-    fflush(Logfile);
-#endif
-    
+
+    if(m_bIOThreadRunning)  // the I/O thread follows the movement for us
+        return m_bDomeIsMoving;
+
+    // decode everything the controller sent since the last poll, the final INF record ends the movement.
+    nErr = drainRx();
     if(nErr) {
-        if(nErr == DDW_TIMEOUT) {
-            if(strlen(szResp)) {
-                // is there a partial INF response in there.
-                if(szResp[0] == 'V') {
-                    m_bDomeIsMoving = false;
-#if defined DDW_DEBUG && DDW_DEBUG >= 2
-                    ltime = time(NULL);
-                    timestamp = asctime(localtime(&ltime));
-                    timestamp[strlen(timestamp) - 1] = 0;
-                    fprintf(Logfile, "[%s] [CddwDome::isDomeMoving] [DDW_TIMEOUT] resp starts with 'V', we're done moving\n", timestamp);
-                    fflush(Logfile);
-#endif
-                }
-                else {
-#if defined DDW_DEBUG && DDW_DEBUG >= 2
-                    ltime = time(NULL);
-                    timestamp = asctime(localtime(&ltime));
-                    timestamp[strlen(timestamp) - 1] = 0;
-                    fprintf(Logfile, "[%s] [CddwDome::isDomeMoving] [DDW_TIMEOUT] resp doesn't starts with 'V', still moving ?\n", timestamp);
-                    fflush(Logfile);
-#endif
-                    m_bDomeIsMoving = true; // we're probably still moving but haven't got  L,R,T,C,O,S or Pxxx since last time we checked
-                }
-            }
-            
-            if((dataReceivedTimer.GetElapsedSeconds() >= 30.0f) && m_bDomeIsMoving) {
 #if defined DDW_DEBUG && DDW_DEBUG >= 2
-                ltime = time(NULL);
-                timestamp = asctime(localtime(&ltime));
-                timestamp[strlen(timestamp) - 1] = 0;
-                fprintf(Logfile, "[%s] [CddwDome::isDomeMoving] [DDW_TIMEOUT] dataReceivedTimer.GetElapsedSeconds() = %3.2f\n", timestamp, dataReceivedTimer.GetElapsedSeconds());
-                fflush(Logfile);
-#endif
-                // we might have missed the GINV response, send a GINV
-                m_bDomeIsMoving = false;
-                nErr = getInfRecord();
-            }
-        }
-        else {
-#if defined DDW_DEBUG && DDW_DEBUG >= 2
-            ltime = time(NULL);
-            timestamp = asctime(localtime(&ltime));
-            timestamp[strlen(timestamp) - 1] = 0;
-            fprintf(Logfile, "[%s] [CddwDome::isDomeMoving] [DDW_TIMEOUT] no response from dome, let's assume it stopped ?\n", timestamp);
-            fflush(Logfile);
+        DDW_LOG(DDW_LOG_VERBOSE, "[CddwDome::isDomeMoving] read error %d, let's assume it stopped ?\n", nErr);
 #endif
-            m_bDomeIsMoving = false;   // there was an actuel error ?
-        }
+        m_bDomeIsMoving = false;   // there was an actuel error ?
+        motionStopped(false);
     }
-    else if(strlen(szResp)) {  // no error, let's look at the response
-        switch(szResp[0]) {
-            case 'V':    // getting INF = we're done with the current opperation
-#if defined DDW_DEBUG && DDW_DEBUG >= 2
-                ltime = time(NULL);
-                timestamp = asctime(localtime(&ltime));
-                timestamp[strlen(timestamp) - 1] = 0;
-                fprintf(Logfile, "[%s] [CddwDome::isDomeMoving] resp[0] is 'V', we're done moving\n", timestamp);
-                fflush(Logfile);
-#endif
-                m_bDomeIsMoving = false;
-                nErr = getInfRecord();
-                dataReceivedTimer.Reset();
-                break;
-            case 'L':    // moving Left
-            case 'R':    // moving Right
-            case 'T':    // Az Tick
-			case 'C':    // Closing shutter
-			case 'O':    // Opening shutter
-            case 'S':    // Manual ops
-                m_bDomeIsMoving  = true;
-                dataReceivedTimer.Reset();
+    else if(m_bDomeIsMoving && dataReceivedTimer.GetElapsedSeconds() >= 30.0f) {
 #if defined DDW_DEBUG && DDW_DEBUG >= 2
-                ltime = time(NULL);
-                timestamp = asctime(localtime(&ltime));
-                timestamp[strlen(timestamp) - 1] = 0;
-                fprintf(Logfile, "[%s] [CddwDome::isDomeMoving] resp[0] is in [L,R,T,S], we're still moving\n", timestamp);
-                fflush(Logfile);
+        DDW_LOG(DDW_LOG_VERBOSE, "[CddwDome::isDomeMoving] nothing received for %3.2f seconds\n", dataReceivedTimer.GetElapsedSeconds());
 #endif
-                break;
-            case 'P':    // moving and reporting position
-#if defined DDW_DEBUG && DDW_DEBUG >= 2
-                ltime = time(NULL);
-                timestamp = asctime(localtime(&ltime));
-                timestamp[strlen(timestamp) - 1] = 0;
-                fprintf(Logfile, "[%s] [CddwDome::isDomeMoving] resp[0] is 'P' we're still moving and updating position\n", timestamp);
-                fflush(Logfile);
-#endif
-                m_bDomeIsMoving  = true;
-                nConvErr = parseFields(szResp, vFieldsData, 'P');
-                if(!nConvErr && m_nNbStepPerRev && vFieldsData.size()) {
-                    try {
-                        m_dCurrentAzPosition = (360.0/m_nNbStepPerRev) * std::stof(vFieldsData[0]);
-                    } catch(const std::exception& e) {
-#if defined DDW_DEBUG
-                        ltime = time(NULL);
-                        timestamp = asctime(localtime(&ltime));
-                        timestamp[strlen(timestamp) - 1] = 0;
-                        fprintf(Logfile, "[%s] [CddwDome::isDomeMoving] std::stof exception : %s\n", timestamp, e.what());
-                        fflush(Logfile);
-#endif
-                        return false;
-                    }
-                }
-                dataReceivedTimer.Reset();
-                break;
-            default :    // shouldn't happen !
-                m_bDomeIsMoving  = false;
-                break;
-        }
+        // we might have missed the INF record, ask for it
+        m_bDomeIsMoving = false;
+        motionStopped(false);
+        getInfRecord(true);
     }
     
 #if defined DDW_DEBUG && DDW_DEBUG >= 2
-    ltime = time(NULL);
-    timestamp = asctime(localtime(&ltime));
-    timestamp[strlen(timestamp) - 1] = 0;
-    fprintf(Logfile, "[%s] [CddwDome::isDomeMoving] isMoving = %s\n", timestamp, m_bDomeIsMoving?"True":"False");
-    fflush(Logfile);
+    DDW_LOG(DDW_LOG_VERBOSE, "[CddwDome::isDomeMoving] isMoving = %s\n", m_bDomeIsMoving?"True":"False");
 #endif
     
     return m_bDomeIsMoving;
@@ -1534,39 +1509,23 @@ bool CddwDome::isDomeAtHome()
         return bHomed;
     
 #if defined DDW_DEBUG
-    ltime = time(NULL);
-    timestamp = asctime(localtime(&ltime));
-    timestamp[strlen(timestamp) - 1] = 0;
-    fprintf(Logfile, "[%s] [CddwDome::isDomeAtHome] ***********************\n", timestamp);
-    fflush(Logfile);
+    DDW_LOG(DDW_LOG_INFO, "[CddwDome::isDomeAtHome] ***********************\n");
 #endif
     
     nErr = getInfRecord();
     if(nErr)
         return bHomed;
     
-    try {
-        if(std::stoi(m_svGinf[gHome]) == AT_HOME) {
-            bHomed  = true;
-            m_bDomeIsMoving = false;
-        }
-    } catch(const std::exception& e) {
-#if defined DDW_DEBUG
-        ltime = time(NULL);
-        timestamp = asctime(localtime(&ltime));
-        timestamp[strlen(timestamp) - 1] = 0;
-        fprintf(Logfile, "[%s] [CddwDome::isDomeAtHome] std::stof exception : %s\n", timestamp, e.what());
-        fflush(Logfile);
-#endif
+    if(!m_GinfRecord.bValid)
         return bHomed;
+
+    if(m_GinfRecord.nHome == AT_HOME) {
+        bHomed  = true;
+        m_bDomeIsMoving = false;
     }
 
 #if defined DDW_DEBUG && DDW_DEBUG >= 2
-    ltime = time(NULL);
-    timestamp = asctime(localtime(&ltime));
-    timestamp[strlen(timestamp) - 1] = 0;
-    fprintf(Logfile, "[%s] [CddwDome::isDomeAtHome] bHomed = %s\n", timestamp, bHomed?"True":"False");
-    fflush(Logfile);
+    DDW_LOG(DDW_LOG_VERBOSE, "[CddwDome::isDomeAtHome] bHomed = %s\n", bHomed?"True":"False");
 #endif
     
     return bHomed;
@@ -1576,6 +1535,8 @@ bool CddwDome::isDomeAtHome()
 
 int CddwDome::isGoToComplete(bool &bComplete)
 {
+    CStateLock lock(this);
+
     int nErr = DDW_OK;
     double dDomeAz = 0;
 
@@ -1583,11 +1544,7 @@ int CddwDome::isGoToComplete(bool &bComplete)
         return NOT_CONNECTED;
 
 #if defined DDW_DEBUG
-	ltime = time(NULL);
-	timestamp = asctime(localtime(&ltime));
-	timestamp[strlen(timestamp) - 1] = 0;
-	fprintf(Logfile, "[%s] [CddwDome::isGoToComplete] ***********************\n", timestamp);
-	fflush(Logfile);
+	DDW_LOG(DDW_LOG_INFO, "[CddwDome::isGoToComplete] ***********************\n");
 #endif
 
 	bComplete = false;
@@ -1595,12 +1552,10 @@ int CddwDome::isGoToComplete(bool &bComplete)
     if(!m_bDomeIsMoving) { // case of a goto to current position.
         bComplete = true;
         nErr = getDomeAz(dDomeAz);
+        if(!nErr)
+            learnCoast(dDomeAz);  // the I/O thread saw it stop
 #if defined DDW_DEBUG && DDW_DEBUG >= 2
-        ltime = time(NULL);
-        timestamp = asctime(localtime(&ltime));
-        timestamp[strlen(timestamp) - 1] = 0;
-        fprintf(Logfile, "[%s] [CddwDome::isGoToComplete] dDomeAz = %3.2f, m_bDomeIsMoving = %s, bComplete = %s\n", timestamp, dDomeAz, m_bDomeIsMoving?"True":"False", bComplete?"True":"False");
-        fflush(Logfile);
+        DDW_LOG(DDW_LOG_VERBOSE, "[CddwDome::isGoToComplete] dDomeAz = %3.2f, m_bDomeIsMoving = %s, bComplete = %s\n", dDomeAz, m_bDomeIsMoving?"True":"False", bComplete?"True":"False");
 #endif
         return nErr;
     }
@@ -1612,17 +1567,14 @@ int CddwDome::isGoToComplete(bool &bComplete)
     nErr = getDomeAz(dDomeAz);
     if(nErr)
         return nErr;
+    learnCoast(dDomeAz);    // on target or not
 
 #if defined DDW_DEBUG && DDW_DEBUG >= 2
-    ltime = time(NULL);
-    timestamp = asctime(localtime(&ltime));
-    timestamp[strlen(timestamp) - 1] = 0;
-    fprintf(Logfile, "[%s] [CddwDome::isGoToComplete] m_dCoastDeg = %3.2f\n", timestamp, m_dCoastDeg);
-    fprintf(Logfile, "[%s] [CddwDome::isGoToComplete] domeAz = %f, mGotoAz = %f.\n", timestamp, dDomeAz, m_dGotoAz);
-    fprintf(Logfile, "[%s] [CddwDome::isGoToComplete] m_dGotoAz = %3.2f, dDomeAz + m_dCoastDeg = %3.2f, dDomeAz - m_dCoastDeg = %3.2f\n", timestamp, m_dGotoAz, dDomeAz + m_dCoastDeg, dDomeAz - m_dCoastDeg);
-	fprintf(Logfile, "[%s] [CddwDome::isGoToComplete] m_dGotoAz = %3.2f, ceil(dDomeAz + m_dCoastDeg) = %3.2f, floor(dDomeAz - m_dCoastDeg) = %3.2f\n", timestamp, m_dGotoAz, ceil(dDomeAz + m_dCoastDeg), floor(dDomeAz - m_dCoastDeg));
-    fprintf(Logfile, "[%s] [CddwDome::isGoToComplete] (m_dGotoAz <= ceil(dDomeAz + m_dCoastDeg)) = %d , (m_dGotoAz >= floor(dDomeAz - m_dCoastDeg)) = %d  \nn", timestamp, (m_dGotoAz <= ceil(dDomeAz + m_dCoastDeg)), (m_dGotoAz >= floor(dDomeAz - m_dCoastDeg)) );
-    fflush(Logfile);
+    DDW_LOG(DDW_LOG_VERBOSE, "[CddwDome::isGoToComplete] m_dCoastDeg = %3.2f\n", m_dCoastDeg);
+    DDW_LOG(DDW_LOG_VERBOSE, "[CddwDome::isGoToComplete] domeAz = %f, mGotoAz = %f.\n", dDomeAz, m_dGotoAz);
+    DDW_LOG(DDW_LOG_VERBOSE, "[CddwDome::isGoToComplete] m_dGotoAz = %3.2f, dDomeAz + m_dCoastDeg = %3.2f, dDomeAz - m_dCoastDeg = %3.2f\n", m_dGotoAz, dDomeAz + m_dCoastDeg, dDomeAz - m_dCoastDeg);
+	DDW_LOG(DDW_LOG_VERBOSE, "[CddwDome::isGoToComplete] m_dGotoAz = %3.2f, ceil(dDomeAz + m_dCoastDeg) = %3.2f, floor(dDomeAz - m_dCoastDeg) = %3.2f\n", m_dGotoAz, ceil(dDomeAz + m_dCoastDeg), floor(dDomeAz - m_dCoastDeg));
+    DDW_LOG(DDW_LOG_VERBOSE, "[CddwDome::isGoToComplete] (m_dGotoAz <= ceil(dDomeAz + m_dCoastDeg)) = %d , (m_dGotoAz >= floor(dDomeAz - m_dCoastDeg)) = %d  \nn", (m_dGotoAz <= ceil(dDomeAz + m_dCoastDeg)), (m_dGotoAz >= floor(dDomeAz - m_dCoastDeg)) );
 #endif
 
 	if (( m_dGotoAz <= ceil(dDomeAz + m_dCoastDeg) ) && (m_dGotoAz >= floor(dDomeAz - m_dCoastDeg) )) {
@@ -1631,22 +1583,14 @@ int CddwDome::isGoToComplete(bool &bComplete)
     else {
         // we're not moving and we're not at the final destination !!!
 #if defined DDW_DEBUG && DDW_DEBUG >= 2
-        ltime = time(NULL);
-        timestamp = asctime(localtime(&ltime));
-        timestamp[strlen(timestamp) - 1] = 0;
-        fprintf(Logfile, "[%s] [CddwDome::isGoToComplete] domeAz = %f, mGotoAz = %f.\n", timestamp, ceil(dDomeAz), ceil(m_dGotoAz));
-        fflush(Logfile);
+        DDW_LOG(DDW_LOG_VERBOSE, "[CddwDome::isGoToComplete] domeAz = %f, mGotoAz = %f.\n", ceil(dDomeAz), ceil(m_dGotoAz));
 #endif
-        bComplete = false;
-        nErr = ERR_CMDFAILED;
+        bComplete = m_bMotionAborted;   // stopped on purpose
+        nErr = m_bMotionAborted ? DDW_OK : ERR_CMDFAILED;
     }
 
 #if defined DDW_DEBUG && DDW_DEBUG >= 2
-    ltime = time(NULL);
-    timestamp = asctime(localtime(&ltime));
-    timestamp[strlen(timestamp) - 1] = 0;
-    fprintf(Logfile, "[%s] [CddwDome::isGoToComplete] bComplete = %s\n", timestamp, bComplete?"True":"False");
-    fflush(Logfile);
+    DDW_LOG(DDW_LOG_VERBOSE, "[CddwDome::isGoToComplete] bComplete = %s\n", bComplete?"True":"False");
 #endif
 
     return nErr;
@@ -1654,17 +1598,15 @@ int CddwDome::isGoToComplete(bool &bComplete)
 
 int CddwDome::isOpenComplete(bool &bComplete)
 {
+    CStateLock lock(this);
+
     int nErr = DDW_OK;
 
     if(!m_bIsConnected)
         return NOT_CONNECTED;
 
 #if defined DDW_DEBUG
-	ltime = time(NULL);
-	timestamp = asctime(localtime(&ltime));
-	timestamp[strlen(timestamp) - 1] = 0;
-	fprintf(Logfile, "[%s] [CddwDome::isOpenComplete] ***********************\n", timestamp);
-	fflush(Logfile);
+	DDW_LOG(DDW_LOG_INFO, "[CddwDome::isOpenComplete] ***********************\n");
 #endif
 
 
@@ -1673,11 +1615,7 @@ int CddwDome::isOpenComplete(bool &bComplete)
 	if(!m_bDomeIsMoving) {
         bComplete = true;
 #if defined DDW_DEBUG && DDW_DEBUG >= 2
-        ltime = time(NULL);
-        timestamp = asctime(localtime(&ltime));
-        timestamp[strlen(timestamp) - 1] = 0;
-        fprintf(Logfile, "[%s] [CddwDome::isOpenComplete] m_bDomeIsMoving = %s, bComplete = %s\n", timestamp, m_bDomeIsMoving?"True":"False", bComplete?"True":"False");
-        fflush(Logfile);
+        DDW_LOG(DDW_LOG_VERBOSE, "[CddwDome::isOpenComplete] m_bDomeIsMoving = %s, bComplete = %s\n", m_bDomeIsMoving?"True":"False", bComplete?"True":"False");
 #endif
         return nErr;
     }
@@ -1695,32 +1633,27 @@ int CddwDome::isOpenComplete(bool &bComplete)
         }
         else {
             m_dCurrentElPosition = 0.0;
-            nErr =  ERR_CMDFAILED;  // we're done opening and yet it's not open !
+            if(!m_bMotionAborted)
+                nErr =  ERR_CMDFAILED;  // we're done opening and yet it's not open !
         }
     }
 #if defined DDW_DEBUG && DDW_DEBUG >= 2
-    ltime = time(NULL);
-    timestamp = asctime(localtime(&ltime));
-    timestamp[strlen(timestamp) - 1] = 0;
-    fprintf(Logfile, "[%s] [CddwDome::isOpenComplete] bComplete = %s, nErr = %d\n", timestamp, bComplete?"True":"False", nErr);
-    fflush(Logfile);
+    DDW_LOG(DDW_LOG_VERBOSE, "[CddwDome::isOpenComplete] bComplete = %s, nErr = %d\n", bComplete?"True":"False", nErr);
 #endif
     return nErr;
 }
 
 int CddwDome::isCloseComplete(bool &bComplete)
 {
+    CStateLock lock(this);
+
     int nErr = DDW_OK;
 
     if(!m_bIsConnected)
         return NOT_CONNECTED;
 
 #if defined DDW_DEBUG
-	ltime = time(NULL);
-	timestamp = asctime(localtime(&ltime));
-	timestamp[strlen(timestamp) - 1] = 0;
-	fprintf(Logfile, "[%s] [CddwDome::isCloseComplete] ***********************\n", timestamp);
-	fflush(Logfile);
+	DDW_LOG(DDW_LOG_INFO, "[CddwDome::isCloseComplete] ***********************\n");
 #endif
 
     bComplete = false;
@@ -1728,11 +1661,7 @@ int CddwDome::isCloseComplete(bool &bComplete)
 	if(!m_bDomeIsMoving) {
         bComplete = true;
 #if defined DDW_DEBUG && DDW_DEBUG >= 2
-        ltime = time(NULL);
-        timestamp = asctime(localtime(&ltime));
-        timestamp[strlen(timestamp) - 1] = 0;
-        fprintf(Logfile, "[%s] [CddwDome::isCloseComplete] m_bDomeIsMoving = %s, bComplete = %s\n", timestamp, m_bDomeIsMoving?"True":"False", bComplete?"True":"False");
-        fflush(Logfile);
+        DDW_LOG(DDW_LOG_VERBOSE, "[CddwDome::isCloseComplete] m_bDomeIsMoving = %s, bComplete = %s\n", m_bDomeIsMoving?"True":"False", bComplete?"True":"False");
 #endif
         return nErr;
     }
@@ -1750,15 +1679,12 @@ int CddwDome::isCloseComplete(bool &bComplete)
         }
         else {
             m_dCurrentElPosition = 90.0;
-            nErr = ERR_CMDFAILED; // we're done closing and yet it's not closed !
+            if(!m_bMotionAborted)
+                nErr = ERR_CMDFAILED; // we're done closing and yet it's not closed !
         }
     }
 #if defined DDW_DEBUG && DDW_DEBUG >= 2
-    ltime = time(NULL);
-    timestamp = asctime(localtime(&ltime));
-    timestamp[strlen(timestamp) - 1] = 0;
-    fprintf(Logfile, "[%s] [CddwDome::isCloseComplete] bComplete = %s, nErr = %d\n", timestamp, bComplete?"True":"False", nErr);
-    fflush(Logfile);
+    DDW_LOG(DDW_LOG_VERBOSE, "[CddwDome::isCloseComplete] bComplete = %s, nErr = %d\n", bComplete?"True":"False", nErr);
 #endif
 
     return nErr;
@@ -1767,17 +1693,15 @@ int CddwDome::isCloseComplete(bool &bComplete)
 
 int CddwDome::isParkComplete(bool &bComplete)
 {
+    CStateLock lock(this);
+
     int nErr = DDW_OK;
 
     if(!m_bIsConnected)
         return NOT_CONNECTED;
 
 #if defined DDW_DEBUG
-    ltime = time(NULL);
-    timestamp = asctime(localtime(&ltime));
-    timestamp[strlen(timestamp) - 1] = 0;
-    fprintf(Logfile, "[%s] [CddwDome::isParkComplete] ***********************\n", timestamp);
-    fflush(Logfile);
+    DDW_LOG(DDW_LOG_INFO, "[CddwDome::isParkComplete] ***********************\n");
 #endif
 
     nErr = isFindHomeComplete(bComplete);
@@ -1785,23 +1709,21 @@ int CddwDome::isParkComplete(bool &bComplete)
         return nErr;
 
     if(bComplete)
-        m_bParked = true;
+        m_nParkState = PARKED;
     return nErr;
 }
 
 int CddwDome::isUnparkComplete(bool &bComplete)
 {
+    CStateLock lock(this);
+
     int nErr = DDW_OK;
 
     if(!m_bIsConnected)
         return NOT_CONNECTED;
 
 #if defined DDW_DEBUG
-    ltime = time(NULL);
-    timestamp = asctime(localtime(&ltime));
-    timestamp[strlen(timestamp) - 1] = 0;
-    fprintf(Logfile, "[%s] [CddwDome::isUnparkComplete] ***********************\n", timestamp);
-    fflush(Logfile);
+    DDW_LOG(DDW_LOG_INFO, "[CddwDome::isUnparkComplete] ***********************\n");
 #endif
 
     nErr = isFindHomeComplete(bComplete);
@@ -1809,7 +1731,7 @@ int CddwDome::isUnparkComplete(bool &bComplete)
         return nErr;
 
     if(bComplete) {
-        m_bParked = false;
+        m_nParkState = UNPARKED;
     }
 
     return nErr;
@@ -1817,19 +1739,31 @@ int CddwDome::isUnparkComplete(bool &bComplete)
 
 int CddwDome::isFindHomeComplete(bool &bComplete)
 {
+    CStateLock lock(this);
+
     int nErr = DDW_OK;
 
     if(!m_bIsConnected)
         return NOT_CONNECTED;
 
 #if defined DDW_DEBUG
-    ltime = time(NULL);
-    timestamp = asctime(localtime(&ltime));
-    timestamp[strlen(timestamp) - 1] = 0;
-    fprintf(Logfile, "[%s] [CddwDome::isFindHomeComplete] ***********************\n", timestamp);
-    fflush(Logfile);
+    DDW_LOG(DDW_LOG_INFO, "[CddwDome::isFindHomeComplete] ***********************\n");
 #endif
 
+    // goHome found us home with the wrong az and started a resync
+    if(m_bResyncing) {
+        if(!m_bIOThreadRunning) // the I/O thread advances it by itself
+            advanceResync();
+        if(m_bResyncing) {
+            bComplete = false;
+            return nErr;
+        }
+    }
+    if(m_nResyncState == RESYNC_FAILED) {
+        bComplete = false;
+        return ERR_CMDFAILED;
+    }
+
     if(isDomeMoving()) {
         bComplete = false;
         return nErr;
@@ -1841,22 +1775,14 @@ int CddwDome::isFindHomeComplete(bool &bComplete)
     else {
         // we're not moving and we're not at the home position !!!
 #if defined DDW_DEBUG && DDW_DEBUG >= 2
-        ltime = time(NULL);
-        timestamp = asctime(localtime(&ltime));
-        timestamp[strlen(timestamp) - 1] = 0;
-        fprintf(Logfile, "[%s] [CddwDome::isFindHomeComplete] Not moving and not at home !!!\n", timestamp);
-        fflush(Logfile);
+        DDW_LOG(DDW_LOG_VERBOSE, "[CddwDome::isFindHomeComplete] Not moving and not at home !!!\n");
 #endif
         bComplete = false;
         nErr = ERR_CMDFAILED;
     }
 
 #if defined DDW_DEBUG && DDW_DEBUG >= 2
-    ltime = time(NULL);
-    timestamp = asctime(localtime(&ltime));
-    timestamp[strlen(timestamp) - 1] = 0;
-    fprintf(Logfile, "[%s] [CddwDome::isFindHomeComplete] bComplete = %s\n", timestamp, bComplete?"True":"False");
-    fflush(Logfile);
+    DDW_LOG(DDW_LOG_VERBOSE, "[CddwDome::isFindHomeComplete] bComplete = %s\n", bComplete?"True":"False");
 #endif
 
    return nErr;
@@ -1865,6 +1791,8 @@ int CddwDome::isFindHomeComplete(bool &bComplete)
 
 int CddwDome::isCalibratingComplete(bool &bComplete)
 {
+    CStateLock lock(this);
+
     int nErr = DDW_OK;
     double dDomeAz = 0;
 
@@ -1872,11 +1800,7 @@ int CddwDome::isCalibratingComplete(bool &bComplete)
         return NOT_CONNECTED;
 
 #if defined DDW_DEBUG
-	ltime = time(NULL);
-	timestamp = asctime(localtime(&ltime));
-	timestamp[strlen(timestamp) - 1] = 0;
-	fprintf(Logfile, "[%s] [CddwDome::isCalibratingComplete] ***********************\n", timestamp);
-	fflush(Logfile);
+	DDW_LOG(DDW_LOG_INFO, "[CddwDome::isCalibratingComplete] ***********************\n");
 #endif
 
 	if(isDomeMoving()) {
@@ -1901,11 +1825,7 @@ int CddwDome::isCalibratingComplete(bool &bComplete)
     m_bDomeIsMoving = false;
 
 #if defined DDW_DEBUG && DDW_DEBUG >= 2
-    ltime = time(NULL);
-    timestamp = asctime(localtime(&ltime));
-    timestamp[strlen(timestamp) - 1] = 0;
-    fprintf(Logfile, "[%s] [CddwDome::isCalibratingComplete] bComplete = %s\n", timestamp, bComplete?"True":"False");
-    fflush(Logfile);
+    DDW_LOG(DDW_LOG_VERBOSE, "[CddwDome::isCalibratingComplete] bComplete = %s\n", bComplete?"True":"False");
 #endif
     return nErr;
 }
@@ -1916,6 +1836,8 @@ int CddwDome::isCalibratingComplete(bool &bComplete)
 
 int CddwDome::getNbTicksPerRev()
 {
+    CStateLock lock(this);
+
     int nErr = DDW_OK;
     if(m_bIsConnected)
         nErr = getDomeStepPerRev();
@@ -1925,6 +1847,8 @@ int CddwDome::getNbTicksPerRev()
 
 double CddwDome::getHomeAz()
 {
+    CStateLock lock(this);
+
     if(m_bIsConnected)
         getDomeHomeAz();
 
@@ -1933,14 +1857,19 @@ double CddwDome::getHomeAz()
 
 double CddwDome::getCurrentAz()
 {
+    CStateLock lock(this);
+    double dDomeAz = m_dCurrentAzPosition;
+
     if(m_bIsConnected)
-        getDomeAz(m_dCurrentAzPosition);
+        getDomeAz(dDomeAz);     // interpolated while the dome rotates
     
-    return m_dCurrentAzPosition;
+    return dDomeAz;
 }
 
 double CddwDome::getCurrentEl()
 {
+    CStateLock lock(this);
+
     if(m_bIsConnected)
         getDomeEl(m_dCurrentElPosition);
     
@@ -1949,6 +1878,8 @@ double CddwDome::getCurrentEl()
 
 int CddwDome::getCurrentShutterState()
 {
+    CStateLock lock(this);
+
     if(m_bIsConnected)
         getShutterState();
 
@@ -1956,48 +1887,219 @@ int CddwDome::getCurrentShutterState()
     return m_nShutterState;
 }
 
+void CddwDome::setLogLevel(int nLevel)
+{
+#ifdef DDW_DEBUG
+    if(nLevel > DDW_DEBUG)
+        nLevel = DDW_DEBUG;
+    if(nLevel > DDW_LOG_OFF && !m_Logger.isOpen()) {
+        m_Logger.open(m_sLogfilePath);
+        m_nLogLevel = nLevel;
+        DDW_LOG(DDW_LOG_INFO, "[CddwDome::setLogLevel] Version 2019_08_26_2000.\n");
+    }
+    m_nLogLevel = nLevel;
+#endif
+}
+
+std::string CddwDome::getCoastModel()
+{
+    std::lock_guard<std::recursive_mutex> lock(m_StateMutex);
+
+    m_bCoastModelChanged = false;
+    return m_CoastModel.serialize();
+}
+
+void CddwDome::setCoastModel(const std::string &sModel)
+{
+    std::lock_guard<std::recursive_mutex> lock(m_StateMutex);
+
+    if(sModel.size() && !m_CoastModel.parse(sModel.c_str())) {
+#if defined DDW_DEBUG
+        DDW_LOG(DDW_LOG_INFO, "[CddwDome::setCoastModel] bad coast model '%s', starting over\n", sModel.c_str());
+#endif
+    }
+    m_bCoastModelChanged = false;
+}
+
+bool CddwDome::dumpCommandStats(const std::string &sPath)
+{
+    bool bOk = m_CmdStats.dump(sPath.size() ? sPath : m_sStatsPath);
+#if defined DDW_DEBUG
+    DDW_LOG(DDW_LOG_INFO, "[CddwDome::dumpCommandStats] statistics written to %s : %s\n", sPath.size() ? sPath.c_str() : m_sStatsPath.c_str(), bOk?"Ok":"Failed");
+#endif
+    return bOk;
+}
+
+bool CddwDome::getDomeState(DomeState &state)
+{
+    m_DomeState.read(state);
+    if(state.bMoving && state.azTrack.bTracking)
+        state.dAz = CAzTracker::estimate(state.azTrack, steadyTimeUs() / 1000000.0);
+
+    if(!state.bConnected || state.bMoving || state.bSelfRefreshing)
+        return true;
+    return (steadyTimeMs() - state.nUpdateTimeMs) < (long long)(state.fRefreshInterval * 1000.0f);
+}
+
+// copy the dome state for the lock free getters, called with m_StateMutex held.
+void CddwDome::publishState()
+{
+    DomeState state;
+
+    state.bConnected = m_bIsConnected;
+    state.bMoving = m_bDomeIsMoving;
+    state.bAtHome = m_GinfRecord.bValid && m_GinfRecord.nHome == AT_HOME;
+    state.bSelfRefreshing = m_bIOThreadRunning;
+    state.nShutterState = m_nShutterState;
+    state.dAz = m_dCurrentAzPosition;
+    state.dEl = (m_bHasShutter && m_bShutterOpened) ? 90.0 : 0.0;
+    state.dHomeAz = m_dHomeAz;
+    state.fRefreshInterval = m_dInfRefreshInterval;
+    state.nUpdateTimeMs = m_nStateUpdateTimeMs;
+    state.azTrack = m_AzTracker.track();
+    state.azTrack.bTracking = state.azTrack.bTracking && m_bDomeIsMoving;
+    m_DomeState.write(state);
+}
+
+// pick the INF polling interval from the dome activity, called with m_StateMutex held.
+void CddwDome::updateInfRefreshInterval()
+{
+    double dNow = steadyTimeMs() / 1000.0;
+
+    if(m_bDomeIsMoving)
+        m_InfScheduler.activity(dNow);  // the fast polling window starts when the movement ends
+    m_dInfRefreshInterval = m_InfScheduler.interval(dNow, m_bDomeIsMoving, m_nParkState == PARKED, m_nShutterState == CLOSED);
+}
 
 #pragma mark - Helper methods
 
+long long CddwDome::steadyTimeMs()
+{
+    return steadyTimeUs() / 1000;
+}
+
+long long CddwDome::steadyTimeUs()
+{
+    if(CStopWatch::timeSource())   // running on a virtual clock
+        return (long long)(CStopWatch::timeSource()() * 1000000.0);
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
 // V4,701,527,4,526,0,1,1,0,522,532,0,128,255,255,255,255,255,255,255,999,5,0
 
-int CddwDome::parseGINF(char *ginf)
+int CddwDome::parseGINF(const char *pszGinf)
 {
-    int nErr = DDW_OK;
-    unsigned int n;
-    std::vector<std::string> vFieldsData;
+    int nFields[NB_GINF_FIELDS];
+    int nNbFields = 0;
+    int nMinFields;
+    int nValue;
+    int nDigits;
+    bool bNegative;
+    const char *pszPtr = pszGinf;
+
+    // single pass over the record, no allocation : "V4,701,527,..." -> nFields[gVersion...]
+    if(*pszPtr != 'V')
+        return DDW_BAD_CMD_RESPONSE;
+    pszPtr++;
+
+    while(*pszPtr && *pszPtr != 0x0D && *pszPtr != 0x0A) {
+        if(*pszPtr == ',') {    // empty field or separator, skip it
+            pszPtr++;
+            continue;
+        }
+        if(nNbFields >= NB_GINF_FIELDS)
+            break;
+
+        bNegative = (*pszPtr == '-');
+        if(bNegative)
+            pszPtr++;
+
+        nValue = 0;
+        nDigits = 0;
+        while(*pszPtr >= '0' && *pszPtr <= '9') {
+            if(++nDigits > 9)   // no GINF field is that long
+                return ERR_BADFORMAT;
+            nValue = (nValue * 10) + (*pszPtr - '0');
+            pszPtr++;
+        }
+        if(!nDigits || (*pszPtr && *pszPtr != ',' && *pszPtr != 0x0D && *pszPtr != 0x0A))
+            return ERR_BADFORMAT;
+
+        nFields[nNbFields++] = bNegative ? -nValue : nValue;
+    }
 
-    nErr = parseFields(ginf, vFieldsData, ',');
     // do we have all the fields ?
-    if (vFieldsData[gVersion] == "V1")
-        n =9;
+    if(nNbFields && nFields[gVersion] == 1)
+        nMinFields = 9;
     else
-        n = 23;
+        nMinFields = 23;
+
+    if(nNbFields < nMinFields)
+        return DDW_BAD_CMD_RESPONSE;
 
-    if(vFieldsData.size() < n)
+    if(!nFields[gDticks])
         return DDW_BAD_CMD_RESPONSE;
 
-    m_svGinf = vFieldsData;
+    memcpy(m_nGinf, nFields, nNbFields * sizeof(int));
+    if(nNbFields < NB_GINF_FIELDS)
+        memset(m_nGinf + nNbFields, 0, (NB_GINF_FIELDS - nNbFields) * sizeof(int));
+    m_nGinfFields = nNbFields;
+
+    decodeGINF();
     return DDW_OK;
 }
 
-int CddwDome::parseFields(const char *pszIn, std::vector<std::string> &svFields, const char &cSeparator)
+// convert the raw GINF fields to the typed record and update the dome state from it, all at once.
+void CddwDome::decodeGINF()
 {
-    int nErr = DDW_OK;
-    std::string sSegment;
-    std::stringstream ssTmp(pszIn);
-
-    svFields.clear();
-    // split the string into vector elements
-    while(std::getline(ssTmp, sSegment, cSeparator))
-    {
-		if(sSegment.size())
-        	svFields.push_back(sSegment);
-    }
-
-    if(svFields.size()==0) {
-        nErr = ERR_BADFORMAT;
-    }
-    return nErr;
+    GinfRecord &rec = m_GinfRecord;
+    bool bStateChanged;
+    bool bWeatherChanged;
+
+    // what changed since the last record drives the polling rate
+    bStateChanged = rec.bValid && (rec.nAzTicks != m_nGinf[gADAZ] || rec.nSlave != m_nGinf[gSlave]
+                                   || rec.nShutterState != m_nGinf[gShutter] || rec.nHome != m_nGinf[gHome]
+                                   || rec.nWetness != m_nGinf[gWETNESS] || rec.nSnow != m_nGinf[gSNOW]);
+    bWeatherChanged = rec.bValid && (rec.nWindDir != m_nGinf[gWINDDIR] || rec.nWindSpeed != m_nGinf[gWINDSPD]
+                                     || rec.nTemp != m_nGinf[gTEMP] || rec.nHumidity != m_nGinf[gHUMID]
+                                     || rec.nWindPeak != m_nGinf[gWINDPEAK]);
+
+    rec.nVersion = m_nGinf[gVersion];
+    rec.nTicksPerRev = m_nGinf[gDticks];
+    rec.nHomeTicks = m_nGinf[gHomeAz];
+    rec.nCoastTicks = m_nGinf[gCoast];
+    rec.nAzTicks = m_nGinf[gADAZ];
+    rec.nSlave = m_nGinf[gSlave];
+    rec.nShutterState = m_nGinf[gShutter];
+    rec.nHome = m_nGinf[gHome];
+
+    // V1 firmware doesn't report the weather station or the dead zone, these stay at 0
+    rec.nWeatherAge = m_nGinf[gWEAAGE];
+    rec.nWindDir = m_nGinf[gWINDDIR];
+    rec.nWindSpeed = m_nGinf[gWINDSPD];
+    rec.nTemp = m_nGinf[gTEMP];
+    rec.nHumidity = m_nGinf[gHUMID];
+    rec.nWetness = m_nGinf[gWETNESS];
+    rec.nSnow = m_nGinf[gSNOW];
+    rec.nWindPeak = m_nGinf[gWINDPEAK];
+    rec.nDeadZone = m_nGinf[gINTDZ];
+
+    rec.dDegPerTick = 360.0 / rec.nTicksPerRev;
+    rec.dAz = rec.dDegPerTick * rec.nAzTicks;
+    rec.dHomeAz = rec.dDegPerTick * rec.nHomeTicks;
+    rec.dCoastDeg = rec.dDegPerTick * rec.nCoastTicks;
+    rec.dDeadZoneDeg = rec.nDeadZone;
+    rec.bShutterOpened = (rec.nShutterState == OPEN);
+    rec.bValid = true;
+
+    m_nNbStepPerRev = rec.nTicksPerRev;
+    m_AzTracker.setDegPerTick(rec.dDegPerTick);
+    m_dCurrentAzPosition = rec.dAz;
+    m_dHomeAz = rec.dHomeAz;
+    m_dCoastDeg = rec.dCoastDeg;
+    m_dDeadZoneDeg = rec.dDeadZoneDeg;
+    m_nShutterState = rec.nShutterState;
+    m_bShutterOpened = rec.bShutterOpened;
+    m_nStateUpdateTimeMs = steadyTimeMs();
+    m_InfScheduler.record(bStateChanged, bWeatherChanged, m_nStateUpdateTimeMs / 1000.0);
 }
-
@@ -29,8 +29,12 @@
 
 #include <string>
 #include <vector>
-#include <sstream>
 #include <iostream>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
 
 #include "../../licensedinterfaces/sberrorx.h"
 #include "../../licensedinterfaces/serxinterface.h"
@@ -38,12 +42,25 @@
 #include "../../licensedinterfaces/sleeperinterface.h"
 
 #include "StopWatch.h"
-
-#define DDW_DEBUG 2
+#include "RxBuffer.h"
+#include "StreamDecoder.h"
+#include "AzTracker.h"
+#include "CoastModel.h"
+#include "SeqLock.h"
+#include "AsyncLogger.h"
+#include "SerialTrace.h"
+#include "CmdStats.h"
+#include "InfScheduler.h"
+#include "CmdQueue.h"
+#include "CancelToken.h"
+
+#define DDW_DEBUG 2     // highest log level compiled in, the level used is set at runtime with setLogLevel()
 
 #define SERIAL_BUFFER_SIZE 4096
 #define MAX_TIMEOUT 2000
 #define ND_LOG_BUFFER_SIZE 256
+#define IO_THREAD_POLL_MS 50
+#define MOTION_WAIT_TIMEOUT 60000     // ms, longest a single blocking movement is waited for
 
 // field indexes in GINF
 #define gVersion     0
@@ -71,6 +88,7 @@
 #define gINTOFF     22
 #define gCR1        23
 #define gCR2        24
+#define NB_GINF_FIELDS  (gCR2 + 1)
 
 // error codes
 // Error code
@@ -80,6 +98,67 @@ enum ddwDomeShutterState {UNKNOWN=0, CLOSED, OPEN};
 
 enum ddwDomeHomeStatus {AT_HOME = 0, NOT_AT_HOME};
 
+// the controller doesn't report it, only a park or unpark done through the driver tells us
+enum ddwParkState {PARK_UNKNOWN = 0, PARKED, UNPARKED};
+
+enum ddwLogLevel {DDW_LOG_OFF = 0, DDW_LOG_INFO, DDW_LOG_VERBOSE};
+
+// home sensor resync started by Connect or goHome
+enum ddwResyncState {RESYNC_IDLE = 0, RESYNC_MOVING_OFF, RESYNC_FINDING_HOME, RESYNC_DONE, RESYNC_FAILED};
+#define RESYNC_STEP_TIMEOUT 60.0f   // seconds
+
+// arguments are only evaluated if the level is enabled
+#ifdef DDW_DEBUG
+#define DDW_LOG(nLevel, ...) do { if(m_nLogLevel.load(std::memory_order_relaxed) >= (nLevel)) m_Logger.log(__VA_ARGS__); } while(0)
+#else
+#define DDW_LOG(nLevel, ...) do { } while(0)
+#endif
+
+// decoded GINF record, built once per INF packet received
+typedef struct {
+    bool    bValid;
+    int     nVersion;
+    int     nTicksPerRev;       // DTICKS
+    int     nAzTicks;           // ADAZ
+    int     nHomeTicks;         // HOMEAZ
+    int     nCoastTicks;        // COAST
+    int     nSlave;
+    int     nShutterState;      // ddwDomeShutterState
+    int     nHome;              // ddwDomeHomeStatus
+    int     nDeadZone;          // INTDZ (V4 and up)
+    // weather station (V4 and up)
+    int     nWeatherAge;
+    int     nWindDir;
+    int     nWindSpeed;
+    int     nTemp;
+    int     nHumidity;
+    int     nWetness;
+    int     nSnow;
+    int     nWindPeak;
+    // derived values
+    double  dDegPerTick;
+    double  dAz;
+    double  dHomeAz;
+    double  dCoastDeg;
+    double  dDeadZoneDeg;
+    bool    bShutterOpened;
+} GinfRecord;
+
+// dome state published for the lock free getters
+typedef struct {
+    bool    bConnected;
+    bool    bMoving;
+    bool    bAtHome;
+    bool    bSelfRefreshing;    // the I/O thread keeps the state up to date
+    int     nShutterState;
+    double  dAz;
+    double  dEl;
+    double  dHomeAz;
+    float   fRefreshInterval;
+    long long nUpdateTimeMs;    // steady clock time of the last INF record
+    AzTrack azTrack;            // dAz is interpolated from it while the dome rotates
+} DomeState;
+
 class CddwDome
 {
 public:
@@ -92,6 +171,10 @@ public:
 
     void        SetSerxPointer(SerXInterface *p) { m_pSerx = p; }
     void        setSleeper(SleeperInterface *pSleeper) { m_pSleeper = pSleeper; };
+    void        setAsyncIO(bool bEnable);   // use a background thread for all serial I/O (from the next Connect)
+    bool        isAsyncIO() { return m_bAsyncIO; }
+    void        setSerialTrace(bool bEnable) { m_bSerialTrace = bEnable; }  // capture the serial traffic (from the next Connect)
+    bool        isSerialTrace() { return m_bSerialTrace; }
 
     // Dome commands
     int syncDome(double dAz, double dEl);
@@ -113,8 +196,12 @@ public:
     int isUnparkComplete(bool &complete);
     int isFindHomeComplete(bool &complete);
     int isCalibratingComplete(bool &complete);
+    int isResyncComplete(bool &complete);   // home sensor resync started by Connect, if any
+    bool isResyncing() { return m_bResyncing; }
 
     int abortCurrentCommand();
+    CCancelToken &cancelToken() { return m_Cancel; }   // hold a CCancelRequest to end the blocking sequence in progress
+    double getLastStopTime() { return m_dLastStopSeconds; }    // seconds from the last STOP to the dome being stopped, -1 if none yet
 
     // getter/setter
     int getNbTicksPerRev();
@@ -127,14 +214,37 @@ public:
 
     int getCurrentShutterState();
 
-    void setDebugLog(bool enable);
+    // lock free copy of the last known state, returns false if it's too old and should be refreshed
+    bool getDomeState(DomeState &state);
+
+    void setLogLevel(int nLevel);   // ddwLogLevel
+    int  getLogLevel() { return m_nLogLevel; }
+
+    // serial command statistics, by ddwCmdType
+    bool getCommandStats(int nCmdType, CmdTypeStats &stats) { return m_CmdStats.get(nCmdType, stats); }
+    void resetCommandStats() { m_CmdStats.reset(); }
+    bool dumpCommandStats(const std::string &sPath = "");   // default is X2_DDWStats.txt in the home directory
+    const std::string &getCommandStatsPath() { return m_sStatsPath; }
+
+    // learned goto overshoot, see CCoastModel. The model is kept by the caller between sessions.
+    void setCoastCompensation(bool bEnable) { m_bCoastCompensation = bEnable; }
+    bool isCoastCompensation() { return m_bCoastCompensation; }
+    std::string getCoastModel();
+    void setCoastModel(const std::string &sModel);
+    bool isCoastModelChanged() { return m_bCoastModelChanged; }    // since the last getCoastModel()
 
 protected:
     
-    int             domeCommand(const char *szCmd, char *szResult, unsigned int nResultMaxLen, unsigned int nTimeout = MAX_TIMEOUT);
-    int             readResponse(char *szRrespBuffer, unsigned int nBufferLen, unsigned int nTimeout = MAX_TIMEOUT);
-    int             readAllResponses(char *respBuffer, unsigned int bufferLen);   // read all the response, only keep the last one.
-    int             getInfRecord();
+    // the response is the first message received after the command, as a ddwEventType.
+    int             domeCommand(const char *szCmd, int *pnResponse, unsigned int nTimeout = MAX_TIMEOUT);
+    int             motionCommand(const char *szCmd, unsigned int nTimeout = MAX_TIMEOUT);
+    int             readResponse(int &nResponse, unsigned int nTimeout = MAX_TIMEOUT);
+    int             drainRx();      // decode what the controller sent since we last looked, doesn't wait
+    int             fillRxBuffer(unsigned int nTimeout);
+    bool            nextEvent(DdwEvent &event);
+    void            dispatchEvents(bool bFlush);
+    int             writeCommand(const char *szCmd, unsigned long &nBytesWrite);
+    int             getInfRecord(bool bForce = false);
 
     int             getDomeAz(double &domeAz);
     int             getDomeEl(double &domeEl);
@@ -146,15 +256,44 @@ protected:
 
     bool            isDomeMoving();
     bool            isDomeAtHome();
+
+    int             startIOThread();
+    void            stopIOThread();
+    void            ioThread();
+    int             postCommand(const char *szCmd, int nPriority = CMD_PRIO_MOTION, long long nDeadlineMs = 0);
+    int             handleEvent(const DdwEvent &event);
+    void            commandAnswered();
+    void            motionStopped(bool bConfirmed);
+    void            learnCoast(double dDomeAz);
     
 
-    int             parseGINF(char *ginf);
-    int             parseFields(const char *pszIn, std::vector<std::string> &svFields, const char &cSeparator);
+    int             parseGINF(const char *pszGinf);
+    void            decodeGINF();
+    void            publishState();
+    void            updateInfRefreshInterval();
+
+    int             findHome(bool bResync);
+    void            checkHomeAz();
+    void            startResync(double dOffsetDeg);
+    void            advanceResync();
+    void            endResync(int nState);
+    static long long steadyTimeMs();
+    static long long steadyTimeUs();
+
+    // holds m_StateMutex and publishes the dome state when going out of scope
+    class CStateLock
+    {
+    public:
+        CStateLock(CddwDome *pDome) : m_pDome(pDome) { m_pDome->m_StateMutex.lock(); }
+        ~CStateLock() { m_pDome->updateInfRefreshInterval(); m_pDome->publishState(); m_pDome->m_StateMutex.unlock(); }
+    private:
+        CddwDome *m_pDome;
+    };
     
     
     LoggerInterface *mLogger;    
     bool            m_bIsConnected;
-    bool            m_bParked;
+    int             m_nParkState;   // ddwParkState
     bool            m_bDomeIsMoving;
     int             m_nNbStepPerRev;
 
@@ -171,6 +310,10 @@ protected:
     double          m_dGotoAz;
 
     SerXInterface   *m_pSerx;
+    CRxBuffer       m_RxBuffer;
+    CStreamDecoder  m_Decoder;
+    long long       m_nRxTimeUs;    // when the data being decoded was read
+    CAzTracker      m_AzTracker;
     SleeperInterface    *m_pSleeper;
 
     char            m_szFirmwareVersion[SERIAL_BUFFER_SIZE];
@@ -178,21 +321,71 @@ protected:
     bool            m_bHasShutter;
     bool            m_bShutterOpened;
 
-    std::vector<std::string>    m_svGinf;
+    int             m_nGinf[NB_GINF_FIELDS];    // last valid GINF record, indexed by gVersion ... gCR2
+    int             m_nGinfFields;
+    GinfRecord      m_GinfRecord;
 	std::string		m_sPort;
 	bool			m_bHardwareFlowControl;
 
     CStopWatch      timer;
     CStopWatch      dataReceivedTimer;
-    float           m_dInfRefreshInterval;;
+    float           m_dInfRefreshInterval;      // set by m_InfScheduler from the dome activity
+    CInfScheduler   m_InfScheduler;
+
+    // background I/O
+    bool                    m_bAsyncIO;
+    std::atomic<bool>       m_bIOThreadRunning;
+    std::thread             m_IOThread;
+    std::recursive_mutex    m_StateMutex;   // dome state shared between the host and the I/O thread
+    CCmdQueue               m_CmdQueue;
+    std::mutex              m_TxMutex;      // one write at a time, a STOP can go out while a command waits for its response
+    CCancelToken            m_Cancel;       // ends the blocking sequences, see CCancelRequest
+
+    // STOP sent, waiting for the controller to confirm the dome stopped
+    bool                    m_bStopPending;
+    bool                    m_bMotionAborted;   // until the next move, the is...Complete checks don't report it as failed
+    long long               m_nStopSentUs;
+    unsigned long           m_nStopRxBytes;
+    std::atomic<double>     m_dLastStopSeconds;
+    bool                    m_bCmdInFlight;
+    CStopWatch              m_CmdTimer;
+
+    // learned goto overshoot
+    CCoastModel             m_CoastModel;
+    bool                    m_bCoastCompensation;
+    std::atomic<bool>       m_bCoastModelChanged;
+    bool                    m_bCoastSample;     // the goto in progress is learned from when it completes
+    int                     m_nGotoDirection;
+    double                  m_dGotoDistance;
+    int                     m_nGotoCmdAz;       // what was sent, may differ from m_dGotoAz
+
+    // home sensor resync
+    int                     m_nResyncState;
+    std::atomic<bool>       m_bResyncing;
+    CStopWatch              m_ResyncTimer;
+    bool                    m_bHomeCheckPending;    // async goHome, checkHomeAz() on the GHOM response
+
+    CSeqLock<DomeState>     m_DomeState;
+    long long               m_nStateUpdateTimeMs;
+
+    // serial traffic capture
+    bool                    m_bSerialTrace;
+    std::string             m_sTracePath;
+    CSerialTrace            m_SerialTrace;
+
+    // command statistics
+    CCmdStats               m_CmdStats;
+    std::string             m_sStatsPath;
+    unsigned long           m_nRxBytes;         // everything read from the port
+    int                     m_nInFlightType;    // I/O thread command waiting for its response
+    long long               m_nInFlightUs;
+    unsigned long           m_nInFlightRx;
 
 #ifdef DDW_DEBUG
     std::string m_sLogfilePath;
-    // timestamp for logs
-    char *timestamp;
-    time_t ltime;
-    FILE *Logfile;      // LogFile
+    CAsyncLogger m_Logger;
 #endif
+    std::atomic<int> m_nLogLevel;
 
 
 };
@@ -0,0 +1,398 @@
+//
+//  DomeSimulator.h
+//
+//  Model of a DDW controller, dome and shutter for the simulation and benchmark tools.
+//
+//  Commands (GINF, Gnnn, GHOM, GOPN, GCLS, GTRN, STOP) are fed with input(), time moves with
+//  advance() and whatever the controller sends is collected with output().
+//  Like the real controller it answers a move with its direction (L/R), streams the position
+//  (Pnnnn, or T per tick) while moving, O/C while the shutter travels and ends every operation
+//  with the INF record (V...). The drive accelerates up to its top speed, cuts the motor when
+//  the target is one coast away and the dome coasts to a stop. Crossing the home sensor resyncs
+//  the position, a GHOM while already on it doesn't.
+//
+
+#ifndef __DOME_SIMULATOR__
+#define __DOME_SIMULATOR__
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include <string>
+
+typedef struct {
+    int     nTicksPerRev;       // DTICKS
+    int     nHomeTicks;         // HOMEAZ
+    int     nCoastTicks;        // COAST
+    int     nDeadZone;          // INTDZ, degrees
+    int     nHomeWidth;         // home sensor width in ticks
+    double  dMaxSpeed;          // deg/s
+    double  dAccel;             // deg/s^2
+    double  dShutterTravel;     // seconds to fully open or close
+    double  dStatusInterval;    // seconds between O/C messages
+    double  dSlipUp;            // degrees coasted past COAST at top speed when the azimuth increases (less when slower)
+    double  dSlipDown;          // same when it decreases
+    bool    bTickMessages;      // send T per tick instead of Pnnnn
+    bool    bBareStatus;        // don't end the one letter messages (L, R, T, O, C) with \r
+    int     nVersion;           // 1 : V1 INF record (9 fields), 4 : V4 (23 fields)
+} DomeSimConfig;
+
+enum DomeSimMotion {SIM_IDLE = 0, SIM_GOTO, SIM_HOME, SIM_TRAIN, SIM_STOPPING};
+enum DomeSimShutter {SIM_SHUTTER_UNKNOWN = 0, SIM_SHUTTER_CLOSED, SIM_SHUTTER_OPEN};
+
+class CDomeSimulator
+{
+public:
+    CDomeSimulator()
+    {
+        m_Config.nTicksPerRev = 701;
+        m_Config.nHomeTicks = 527;
+        m_Config.nCoastTicks = 4;
+        m_Config.nDeadZone = 5;
+        m_Config.nHomeWidth = 8;
+        m_Config.dMaxSpeed = 5.0;
+        m_Config.dAccel = 2.5;
+        m_Config.dShutterTravel = 20.0;
+        m_Config.dStatusInterval = 0.5;
+        m_Config.dSlipUp = 0;
+        m_Config.dSlipDown = 0;
+        m_Config.bTickMessages = false;
+        m_Config.bBareStatus = false;
+        m_Config.nVersion = 4;
+        reset(m_Config, 526);
+    }
+
+    void reset(const DomeSimConfig &config, double dPositionTicks)
+    {
+        m_Config = config;
+        m_dPosition = dPositionTicks;
+        m_dSpeed = 0;
+        m_nDirection = 1;
+        m_nMotion = SIM_IDLE;
+        m_dTarget = 0;
+        m_bMotorOn = false;
+        m_dDecel = m_Config.dAccel;
+        m_nLastTick = (int)floor(m_dPosition);
+        m_dTravelled = 0;
+        m_nShutterState = SIM_SHUTTER_CLOSED;
+        m_nShutterTarget = SIM_SHUTTER_CLOSED;
+        m_dShutterPos = 0;
+        m_dShutterStatusTimer = 0;
+        m_sInput.clear();
+        m_sOutput.clear();
+        m_nCommands = 0;
+        m_nCountError = 0;
+    }
+
+    inline const DomeSimConfig &config() const { return m_Config; }
+
+    // the controller lost count : the home sensor is seen nTicks away from HOMEAZ until the next home
+    inline void setCountError(int nTicks) { m_nCountError = nTicks; }
+    inline int countError() const { return m_nCountError; }
+
+    // bytes received from the plugin
+    void input(const char *pData, size_t nLen)
+    {
+        m_sInput.append(pData, nLen);
+        // commands are 4 characters, STOP may be followed by \n
+        while(m_sInput.size() >= 4) {
+            if(m_sInput[0] == '\r' || m_sInput[0] == '\n') {
+                m_sInput.erase(0, 1);
+                continue;
+            }
+            command(m_sInput.substr(0, 4));
+            m_sInput.erase(0, 4);
+        }
+    }
+
+    // bytes to send to the plugin, the buffer is emptied
+    std::string output()
+    {
+        std::string sOut;
+        sOut.swap(m_sOutput);
+        return sOut;
+    }
+
+    inline bool hasOutput() const { return !m_sOutput.empty(); }
+    inline bool isBusy() const { return m_nMotion != SIM_IDLE || m_nShutterState != m_nShutterTarget; }
+    inline double azimuth() const { return ticksToDeg(m_dPosition); }
+    inline int shutterState() const { return m_nShutterState; }
+    inline int commands() const { return m_nCommands; }
+
+    // move the simulation forward. Small steps (10ms or less) give the most realistic streams.
+    void advance(double dSeconds)
+    {
+        const double dStep = 0.005;
+        double dDt;
+
+        while(dSeconds > 0) {
+            dDt = dSeconds < dStep ? dSeconds : dStep;
+            stepRotation(dDt);
+            stepShutter(dDt);
+            dSeconds -= dDt;
+        }
+    }
+
+    // INF record for the current state
+    std::string infRecord() const
+    {
+        char szInf[256];
+        int nTicks = ticks();
+
+        if(m_Config.nVersion < 4)
+            snprintf(szInf, sizeof(szInf), "V1,%d,%d,%d,%d,0,%d,1,%d\r",
+                     m_Config.nTicksPerRev, m_Config.nHomeTicks, m_Config.nCoastTicks, nTicks,
+                     m_nShutterState, atHome() ? 0 : 1);
+        else
+            snprintf(szInf, sizeof(szInf), "V4,%d,%d,%d,%d,0,%d,1,%d,%d,%d,0,128,255,255,255,255,255,255,255,999,%d,0\r",
+                     m_Config.nTicksPerRev, m_Config.nHomeTicks, m_Config.nCoastTicks, nTicks,
+                     m_nShutterState, atHome() ? 0 : 1,
+                     m_Config.nHomeTicks - 5, m_Config.nHomeTicks + 5, m_Config.nDeadZone);
+        return szInf;
+    }
+
+protected:
+    inline double ticksToDeg(double dTicks) const { return dTicks * 360.0 / m_Config.nTicksPerRev; }
+    inline double degToTicks(double dDeg) const { return dDeg * m_Config.nTicksPerRev / 360.0; }
+
+    inline int ticks() const
+    {
+        int nTicks = (int)floor(m_dPosition + 0.5) % m_Config.nTicksPerRev;
+        return nTicks < 0 ? nTicks + m_Config.nTicksPerRev : nTicks;
+    }
+
+    inline bool atHome() const
+    {
+        int nDist = abs(ticks() - m_Config.nHomeTicks - m_nCountError) % m_Config.nTicksPerRev;
+        if(nDist > m_Config.nTicksPerRev / 2)
+            nDist = m_Config.nTicksPerRev - nDist;
+        return nDist <= m_Config.nHomeWidth / 2;
+    }
+
+    void command(const std::string &sCmd)
+    {
+        int nAz;
+        double dDelta;
+
+        m_nCommands++;
+        if(sCmd == "GINF") {
+            m_sOutput += infRecord();
+        }
+        else if(sCmd == "STOP") {
+            if(m_nMotion != SIM_IDLE)
+                cutMotor();
+            else if(m_nShutterState != m_nShutterTarget) {
+                m_nShutterTarget = m_nShutterState = SIM_SHUTTER_UNKNOWN;
+                m_sOutput += infRecord();
+            }
+            else
+                m_sOutput += infRecord();
+        }
+        else if(sCmd == "GHOM") {
+            if(atHome() && m_nMotion == SIM_IDLE) {
+                // already there, no sensor transition so the count isn't corrected
+                m_sOutput += infRecord();
+                return;
+            }
+            startRotation(SIM_HOME, shortestDirection(m_Config.nHomeTicks + m_nCountError), 0);
+        }
+        else if(sCmd == "GTRN") {
+            startRotation(SIM_TRAIN, 1, 0);
+        }
+        else if(sCmd == "GOPN" || sCmd == "GCLS") {
+            m_nShutterTarget = sCmd == "GOPN" ? SIM_SHUTTER_OPEN : SIM_SHUTTER_CLOSED;
+            if(m_nShutterState == m_nShutterTarget) {
+                m_sOutput += infRecord();
+                return;
+            }
+            m_nShutterState = SIM_SHUTTER_UNKNOWN;
+            m_dShutterStatusTimer = 0;
+            status(m_nShutterTarget == SIM_SHUTTER_OPEN ? 'O' : 'C');
+        }
+        else if(sCmd[0] == 'G' && sscanf(sCmd.c_str() + 1, "%3d", &nAz) == 1) {
+            dDelta = ticksToDeg(shortestDelta(degToTicks(nAz)));
+            if(fabs(dDelta) < m_Config.nDeadZone) {    // too small to move
+                m_sOutput += infRecord();
+                return;
+            }
+            startRotation(SIM_GOTO, dDelta > 0 ? 1 : -1, m_dPosition + degToTicks(dDelta));
+        }
+    }
+
+    // the home sensor resyncs the position count
+    void resync()
+    {
+        m_dPosition -= m_nCountError;
+        if(m_dPosition < 0)
+            m_dPosition += m_Config.nTicksPerRev;
+        else if(m_dPosition >= m_Config.nTicksPerRev)
+            m_dPosition -= m_Config.nTicksPerRev;
+        m_nLastTick = (int)floor(m_dPosition);
+        m_nCountError = 0;
+    }
+
+    inline void status(char cStatus)
+    {
+        m_sOutput += cStatus;
+        if(!m_Config.bBareStatus)
+            m_sOutput += '\r';
+    }
+
+    double shortestDelta(double dTargetTicks) const
+    {
+        double dDelta = fmod(dTargetTicks - m_dPosition, m_Config.nTicksPerRev);
+
+        if(dDelta > m_Config.nTicksPerRev / 2.0)
+            dDelta -= m_Config.nTicksPerRev;
+        else if(dDelta < -m_Config.nTicksPerRev / 2.0)
+            dDelta += m_Config.nTicksPerRev;
+        return dDelta;
+    }
+
+    inline int shortestDirection(double dTargetTicks) const { return shortestDelta(dTargetTicks) >= 0 ? 1 : -1; }
+
+    void startRotation(int nMotion, int nDirection, double dTarget)
+    {
+        if(m_nMotion != SIM_IDLE && nDirection != m_nDirection && m_dSpeed > 0) {
+            // reversing, stop first (the real drive does the same)
+            m_dSpeed = 0;
+        }
+        m_nMotion = nMotion;
+        m_nDirection = nDirection;
+        m_dTarget = dTarget;
+        m_bMotorOn = true;
+        m_dTravelled = 0;
+        status(nDirection > 0 ? 'R' : 'L');
+    }
+
+    // the drive is switched off, the dome coasts to a stop over COAST ticks
+    void cutMotor()
+    {
+        double dSpeedRatio = m_dSpeed / m_Config.dMaxSpeed;
+        double dCoastDeg = ticksToDeg(m_Config.nCoastTicks) + (m_nDirection > 0 ? m_Config.dSlipUp : m_Config.dSlipDown) * dSpeedRatio * dSpeedRatio;
+
+        m_bMotorOn = false;
+        m_dDecel = dCoastDeg > 0 ? (m_dSpeed * m_dSpeed) / (2.0 * dCoastDeg) : 1e9;
+        if(m_dDecel < m_Config.dAccel)
+            m_dDecel = m_Config.dAccel;
+        m_nMotion = m_nMotion == SIM_IDLE ? SIM_IDLE : SIM_STOPPING;
+    }
+
+    void stepRotation(double dDt)
+    {
+        double dMove;
+        double dRemaining;
+        int nTick;
+
+        if(m_nMotion == SIM_IDLE)
+            return;
+
+        if(m_bMotorOn) {
+            m_dSpeed += m_Config.dAccel * dDt;
+            if(m_dSpeed > m_Config.dMaxSpeed)
+                m_dSpeed = m_Config.dMaxSpeed;
+        }
+        else {
+            m_dSpeed -= m_dDecel * dDt;
+            if(m_dSpeed <= 0) {
+                m_dSpeed = 0;
+                m_nMotion = SIM_IDLE;
+                m_sOutput += infRecord();
+                return;
+            }
+        }
+
+        dMove = degToTicks(m_dSpeed * dDt);
+        m_dPosition += m_nDirection * dMove;
+        m_dTravelled += dMove;
+        if(m_dPosition < 0)
+            m_dPosition += m_Config.nTicksPerRev;
+        else if(m_dPosition >= m_Config.nTicksPerRev)
+            m_dPosition -= m_Config.nTicksPerRev;
+
+        // report every tick crossed
+        nTick = (int)floor(m_dPosition);
+        if(nTick != m_nLastTick) {
+            m_nLastTick = nTick;
+            if(m_Config.bTickMessages)
+                status('T');
+            else {
+                char szPos[16];
+                snprintf(szPos, sizeof(szPos), "P%04d\r", ticks());
+                m_sOutput += szPos;
+            }
+        }
+
+        if(!m_bMotorOn)
+            return;
+
+        switch(m_nMotion) {
+            case SIM_GOTO :
+                dRemaining = m_nDirection * shortestDelta(m_dTarget);
+                if(dRemaining <= m_Config.nCoastTicks)
+                    cutMotor();
+                break;
+            case SIM_HOME :
+                if(atHome()) {
+                    resync();
+                    cutMotor();
+                }
+                break;
+            case SIM_TRAIN :
+                // at least one full turn, then stop on the home sensor
+                if(atHome() && m_dTravelled >= m_Config.nTicksPerRev - m_Config.nHomeWidth) {
+                    resync();
+                    cutMotor();
+                }
+                break;
+            default :
+                break;
+        }
+    }
+
+    void stepShutter(double dDt)
+    {
+        if(m_nShutterTarget == m_nShutterState)
+            return;
+
+        m_dShutterPos += (m_nShutterTarget == SIM_SHUTTER_OPEN ? 1 : -1) * dDt / m_Config.dShutterTravel;
+        m_dShutterStatusTimer += dDt;
+        if(m_dShutterPos >= 1.0 || m_dShutterPos <= 0.0) {
+            m_dShutterPos = m_dShutterPos >= 1.0 ? 1.0 : 0.0;
+            m_nShutterState = m_nShutterTarget;
+            m_sOutput += infRecord();
+            return;
+        }
+        if(m_dShutterStatusTimer >= m_Config.dStatusInterval) {
+            m_dShutterStatusTimer = 0;
+            status(m_nShutterTarget == SIM_SHUTTER_OPEN ? 'O' : 'C');
+        }
+    }
+
+    DomeSimConfig   m_Config;
+
+    // rotation, positions in ticks
+    double          m_dPosition;
+    double          m_dSpeed;           // deg/s
+    int             m_nDirection;       // 1 : right (increasing az), -1 : left
+    int             m_nMotion;
+    double          m_dTarget;
+    bool            m_bMotorOn;
+    double          m_dDecel;
+    int             m_nLastTick;
+    int             m_nCountError;      // ticks between the counted and the real position
+    double          m_dTravelled;
+
+    // shutter
+    int             m_nShutterState;
+    int             m_nShutterTarget;
+    double          m_dShutterPos;      // 0 closed, 1 open
+    double          m_dShutterStatusTimer;
+
+    std::string     m_sInput;
+    std::string     m_sOutput;
+    int             m_nCommands;
+};
+
+#endif
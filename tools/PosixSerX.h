@@ -0,0 +1,145 @@
+//
+//  PosixSerX.h
+//
+//  Minimal SerXInterface on a POSIX serial port (or the simulator PTY) for the tools,
+//  standing in for the one TheSkyX gives the plugin. Counts the system calls it makes.
+//
+
+#ifndef __POSIX_SERX__
+#define __POSIX_SERX__
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <termios.h>
+#include <sys/ioctl.h>
+#include <sys/select.h>
+
+#include <atomic>
+
+#include "../../../licensedinterfaces/serxinterface.h"
+
+class CPosixSerX : public SerXInterface
+{
+public:
+    CPosixSerX() { m_nFd = -1; resetCounters(); }
+    virtual ~CPosixSerX() { close(); }
+
+    virtual int open(const char* pszPort, const unsigned long& /*dwBaudRate*/ = 9600, const Parity& /*parity*/ = B_NOPARITY, const char* /*pszSession*/ = 0)
+    {
+        struct termios tio;
+
+        close();
+        m_nSyscalls++;
+        m_nFd = ::open(pszPort, O_RDWR | O_NOCTTY);
+        if(m_nFd < 0)
+            return errno;
+        m_nSyscalls += 2;
+        if(tcgetattr(m_nFd, &tio) == 0) {
+            cfmakeraw(&tio);
+            cfsetispeed(&tio, B9600);
+            cfsetospeed(&tio, B9600);
+            tcsetattr(m_nFd, TCSANOW, &tio);
+        }
+        return 0;
+    }
+
+    virtual int close()
+    {
+        if(m_nFd >= 0) {
+            m_nSyscalls++;
+            ::close(m_nFd);
+        }
+        m_nFd = -1;
+        return 0;
+    }
+
+    virtual bool isConnected() const { return m_nFd >= 0; }
+
+    virtual int flushTx()
+    {
+        m_nSyscalls++;
+        tcdrain(m_nFd);
+        return 0;
+    }
+
+    virtual int purgeTxRx()
+    {
+        m_nSyscalls++;
+        tcflush(m_nFd, TCIOFLUSH);
+        return 0;
+    }
+
+    virtual int bytesWaitingRx(int &nBytesWaitingRx)
+    {
+        m_nSyscalls++;
+        if(ioctl(m_nFd, FIONREAD, &nBytesWaitingRx))
+            return errno;
+        return 0;
+    }
+
+    virtual int readFile(void* lpBuf, const unsigned long dwBytesToRead, unsigned long& pdwBytesRead, const unsigned long& dwTimeOutMs = 1000)
+    {
+        struct timeval tv;
+        fd_set fds;
+        ssize_t nLen;
+        int nSel;
+
+        pdwBytesRead = 0;
+        while(pdwBytesRead < dwBytesToRead) {
+            FD_ZERO(&fds);
+            FD_SET(m_nFd, &fds);
+            tv.tv_sec = dwTimeOutMs / 1000;
+            tv.tv_usec = (dwTimeOutMs % 1000) * 1000;
+            m_nSyscalls++;
+            nSel = select(m_nFd + 1, &fds, NULL, NULL, &tv);
+            if(nSel < 0)
+                return errno;
+            if(nSel == 0)
+                break;  // timeout
+            m_nSyscalls++;
+            nLen = ::read(m_nFd, (char *)lpBuf + pdwBytesRead, dwBytesToRead - pdwBytesRead);
+            if(nLen < 0)
+                return errno;
+            if(nLen == 0)
+                return EIO;
+            pdwBytesRead += nLen;
+            m_nBytesRx += nLen;
+        }
+        return 0;
+    }
+
+    virtual int writeFile(void* lpBuf, const unsigned long& dwBytesToWrite, unsigned long& pdwBytesWritten)
+    {
+        ssize_t nLen;
+
+        m_nSyscalls++;
+        nLen = ::write(m_nFd, lpBuf, dwBytesToWrite);
+        if(nLen < 0) {
+            pdwBytesWritten = 0;
+            return errno;
+        }
+        pdwBytesWritten = nLen;
+        m_nBytesTx += nLen;
+        return 0;
+    }
+
+    void resetCounters()
+    {
+        m_nSyscalls = 0;
+        m_nBytesRx = 0;
+        m_nBytesTx = 0;
+    }
+
+    // read by the host while the I/O thread uses the port
+    std::atomic<unsigned long>  m_nSyscalls;
+    std::atomic<unsigned long>  m_nBytesRx;
+    std::atomic<unsigned long>  m_nBytesTx;
+
+protected:
+    int             m_nFd;
+};
+
+#endif
@@ -0,0 +1,172 @@
+//
+//  SimSerX.h
+//
+//  In-memory SerXInterface connected to a CDomeSimulator, running on the virtual clock.
+//  Nothing blocks : a read that has to wait moves the virtual clock (and the simulated dome)
+//  forward until data shows up or the timeout expires. Use with CVirtualSleeper.
+//  A read from another thread than the one driving the clock (the async I/O thread) waits for
+//  the sleeper to move it instead, the port can be used from both threads.
+//
+
+#ifndef __SIM_SERX__
+#define __SIM_SERX__
+
+#include <string.h>
+
+#include <string>
+#include <deque>
+#include <utility>
+#include <mutex>
+#include <atomic>
+
+#include "../../../licensedinterfaces/serxinterface.h"
+
+#include "VirtualTime.h"
+#include "DomeSimulator.h"
+
+#define SIM_SERX_STEP   0.005   // seconds, how far a blocked read moves the clock at a time
+
+class CSimSerX : public SerXInterface
+{
+public:
+    CSimSerX(CDomeSimulator &sim) : m_Sim(sim)
+    {
+        m_bOpen = false;
+        m_dSimTime = CVirtualClock::seconds();
+        m_dLatency = 0.0;
+        resetCounters();
+    }
+
+    virtual int open(const char* /*pszPort*/, const unsigned long& /*dwBaudRate*/ = 9600, const Parity& /*parity*/ = B_NOPARITY, const char* /*pszSession*/ = 0)
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_nCalls++;
+        m_bOpen = true;
+        m_dSimTime = CVirtualClock::seconds();
+        return 0;
+    }
+
+    virtual int close() { std::lock_guard<std::mutex> lock(m_Mutex); m_nCalls++; m_bOpen = false; return 0; }
+    virtual bool isConnected() const { return m_bOpen; }
+    virtual int flushTx() { std::lock_guard<std::mutex> lock(m_Mutex); m_nCalls++; return 0; }
+
+    virtual int purgeTxRx()
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_nCalls++;
+        sync();
+        m_sRx.clear();
+        return 0;
+    }
+
+    virtual int bytesWaitingRx(int &nBytesWaitingRx)
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_nCalls++;
+        sync();
+        nBytesWaitingRx = (int)m_sRx.size();
+        return 0;
+    }
+
+    virtual int readFile(void* lpBuf, const unsigned long dwBytesToRead, unsigned long& pdwBytesRead, const unsigned long& dwTimeOutMs = 1000)
+    {
+        std::unique_lock<std::mutex> lock(m_Mutex);
+        double dDeadline = CVirtualClock::seconds() + dwTimeOutMs / 1000.0;
+        double dSeen;
+        bool bTicked;
+
+        m_nCalls++;
+        sync();
+        if(CVirtualClock::isDriver()) {
+            while(m_sRx.size() < dwBytesToRead && CVirtualClock::seconds() < dDeadline) {
+                CVirtualClock::advanceTo(CVirtualClock::seconds() + SIM_SERX_STEP < dDeadline ? CVirtualClock::seconds() + SIM_SERX_STEP : dDeadline);
+                sync();
+            }
+        }
+        else {
+            while(m_sRx.size() < dwBytesToRead && CVirtualClock::seconds() < dDeadline) {
+                dSeen = CVirtualClock::seconds();
+                lock.unlock();
+                bTicked = CVirtualClock::waitForTick(dSeen);
+                lock.lock();
+                sync();
+                if(!bTicked)    // the clock isn't moving, don't hold the caller
+                    break;
+            }
+        }
+        pdwBytesRead = m_sRx.size() < dwBytesToRead ? (unsigned long)m_sRx.size() : dwBytesToRead;
+        memcpy(lpBuf, m_sRx.data(), pdwBytesRead);
+        m_sRx.erase(0, pdwBytesRead);
+        m_nBytesRx += pdwBytesRead;
+        return 0;
+    }
+
+    virtual int writeFile(void* lpBuf, const unsigned long& dwBytesToWrite, unsigned long& pdwBytesWritten)
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_nCalls++;
+        sync();
+        m_Sim.input((const char *)lpBuf, dwBytesToWrite);
+        collect(m_dSimTime);    // the immediate response
+        pdwBytesWritten = dwBytesToWrite;
+        m_nBytesTx += dwBytesToWrite;
+        return 0;
+    }
+
+    // transmission delay of the controller output (9600 bauds is about 1ms per byte)
+    void setLatency(double dSeconds) { m_dLatency = dSeconds; }
+
+    void resetCounters()
+    {
+        m_nCalls = 0;
+        m_nBytesRx = 0;
+        m_nBytesTx = 0;
+    }
+
+    // read by the host while the I/O thread uses the port
+    std::atomic<unsigned long>  m_nCalls;       // calls into the port, what would be system calls on a real one
+    std::atomic<unsigned long>  m_nBytesRx;
+    std::atomic<unsigned long>  m_nBytesTx;
+
+protected:
+    // bring the simulated dome up to the virtual time and collect what it sent.
+    // The virtual clock may have jumped far ahead (host sleeps don't go through the port), the
+    // dome is moved in small steps so each message is stamped with the time it was produced.
+    void sync()
+    {
+        double dNow = CVirtualClock::seconds();
+        double dDt;
+
+        while(dNow > m_dSimTime) {
+            dDt = dNow - m_dSimTime < SIM_SERX_STEP ? dNow - m_dSimTime : SIM_SERX_STEP;
+            m_Sim.advance(dDt);
+            m_dSimTime += dDt;
+            collect(m_dSimTime);
+        }
+        m_dSimTime = dNow;
+        collect(dNow);
+        while(!m_Pending.empty() && m_Pending.front().first <= dNow) {
+            m_sRx += m_Pending.front().second;
+            m_Pending.pop_front();
+        }
+    }
+
+    // what the dome sent at dTime reaches the port after the latency
+    inline void collect(double dTime)
+    {
+        if(m_Sim.hasOutput())
+            m_Pending.push_back(PendingOutput(dTime + m_dLatency, m_Sim.output()));
+    }
+
+    typedef std::pair<double, std::string> PendingOutput;
+
+    std::mutex                  m_Mutex;    // the I/O thread reads while the host writes a STOP
+    CDomeSimulator              &m_Sim;
+    bool                        m_bOpen;
+    double                      m_dSimTime;
+    double                      m_dLatency;
+    std::string                 m_sRx;
+    std::deque<PendingOutput>   m_Pending;
+};
+
+#endif
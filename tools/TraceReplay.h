@@ -0,0 +1,278 @@
+//
+//  TraceReplay.h
+//
+//  Stand-in SerXInterface that plays back a serial trace captured by CSerialTrace.
+//
+//  Time is virtual (see VirtualTime.h). Each time the plugin writes the command expected by the
+//  trace, the trace timeline is anchored to the virtual clock. The bytes the controller sent
+//  after that command then become readable with the same delays as on the night of the capture.
+//  A readFile with nothing to read moves the clock forward, up to its timeout or up to the next
+//  received data, so timeouts happen exactly as they did in the field. Read errors recorded in
+//  the trace (EIO, ...) are returned at the same point.
+//
+
+#ifndef __TRACE_REPLAY__
+#define __TRACE_REPLAY__
+
+#include <stdio.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include "../../../licensedinterfaces/serxinterface.h"
+
+#include "../SerialTrace.h"
+#include "VirtualTime.h"
+
+typedef struct {
+    int                 nType;
+    double              dTime;      // seconds since the session start
+    std::string         sData;
+} TraceRecord;
+
+// load one session (from one TRACE_OPEN to the next) of a trace file
+class CTraceReader
+{
+public:
+    CTraceReader() { m_nNbSessions = 0; }
+
+    // returns false if the file can't be read or isn't a trace. nSession is 0 based.
+    bool load(const char *pszPath, int nSession)
+    {
+        FILE *pFile;
+        unsigned char header[TRACE_HEADER_SIZE];
+        char szMagic[TRACE_MAGIC_SIZE];
+        unsigned long long nStartUs = 0;
+        unsigned long long nTimeUs;
+        TraceRecord rec;
+        size_t nLen;
+        int nCurSession = -1;
+
+        m_Records.clear();
+        m_nNbSessions = 0;
+        pFile = fopen(pszPath, "rb");
+        if(!pFile)
+            return false;
+        if(fread(szMagic, 1, TRACE_MAGIC_SIZE, pFile) != TRACE_MAGIC_SIZE || memcmp(szMagic, TRACE_MAGIC, TRACE_MAGIC_SIZE)) {
+            fclose(pFile);
+            return false;
+        }
+
+        while(fread(header, 1, TRACE_HEADER_SIZE, pFile) == TRACE_HEADER_SIZE) {
+            nLen = (size_t)CSerialTrace::getLE(header + 1, 2);
+            nTimeUs = CSerialTrace::getLE(header + 3, 8);
+            rec.nType = header[0];
+            rec.sData.resize(nLen);
+            if(nLen && fread(&rec.sData[0], 1, nLen, pFile) != nLen)
+                break;  // truncated, the plugin was still writing
+            if(rec.nType == TRACE_OPEN) {
+                nCurSession++;
+                m_nNbSessions++;
+                nStartUs = nTimeUs;
+                continue;
+            }
+            if(nCurSession != nSession)
+                continue;
+            rec.dTime = (double)(nTimeUs - nStartUs) / 1000000.0;
+            m_Records.push_back(rec);
+        }
+        fclose(pFile);
+        return nCurSession >= nSession;
+    }
+
+    std::vector<TraceRecord>    m_Records;
+    int                         m_nNbSessions;
+};
+
+class CReplaySerX : public SerXInterface
+{
+public:
+    CReplaySerX(const std::vector<TraceRecord> &records) : m_Records(records)
+    {
+        m_bOpen = false;
+        m_nNext = 0;
+        m_nRxOffset = 0;
+        m_dOffset = 0;
+        m_nNbOpen = 0;
+        m_nTxMatched = 0;
+        m_nTxMismatched = 0;
+        m_nTxSkipped = 0;
+        m_nBytesRx = 0;
+        m_nBytesTx = 0;
+        m_nBytesPurged = 0;
+        m_nNbErrors = 0;
+    }
+
+    virtual int open(const char* /*pszPort*/, const unsigned long& /*dwBaudRate*/ = 9600, const Parity& /*parity*/ = B_NOPARITY, const char* /*pszSession*/ = 0)
+    {
+        m_bOpen = true;
+        m_nNbOpen++;
+        return 0;
+    }
+
+    virtual int close() { m_bOpen = false; return 0; }
+    virtual bool isConnected() const { return m_bOpen; }
+    virtual int flushTx() { return 0; }
+
+    virtual int purgeTxRx()
+    {
+        while(nextRx())
+            consumeRx(m_Records[m_nNext].sData.size() - m_nRxOffset, true);
+        return 0;
+    }
+
+    virtual int bytesWaitingRx(int &nBytesWaitingRx)
+    {
+        size_t i;
+        size_t nOffset = m_nRxOffset;
+
+        nBytesWaitingRx = 0;
+        for(i = m_nNext; i < m_Records.size(); i++) {
+            if(m_Records[i].nType != TRACE_RX || !isDue(i))
+                break;
+            nBytesWaitingRx += (int)(m_Records[i].sData.size() - nOffset);
+            nOffset = 0;
+        }
+        return 0;
+    }
+
+    virtual int readFile(void* lpBuf, const unsigned long dwBytesToRead, unsigned long& pdwBytesRead, const unsigned long& dwTimeOutMs = 1000)
+    {
+        double dDeadline = CVirtualClock::seconds() + dwTimeOutMs / 1000.0;
+        unsigned long nLen;
+        int nErr;
+
+        pdwBytesRead = 0;
+        while(pdwBytesRead < dwBytesToRead) {
+            if(m_nNext < m_Records.size() && m_Records[m_nNext].nType == TRACE_ERROR && isDue(m_nNext)) {
+                if(pdwBytesRead)
+                    break;
+                nErr = (int)CSerialTrace::getLE((const unsigned char *)m_Records[m_nNext].sData.data(), 4);
+                m_nNext++;
+                m_nNbErrors++;
+                return nErr;
+            }
+            if(nextRx()) {
+                nLen = (unsigned long)(m_Records[m_nNext].sData.size() - m_nRxOffset);
+                if(nLen > dwBytesToRead - pdwBytesRead)
+                    nLen = dwBytesToRead - pdwBytesRead;
+                memcpy((char *)lpBuf + pdwBytesRead, m_Records[m_nNext].sData.data() + m_nRxOffset, nLen);
+                pdwBytesRead += nLen;
+                consumeRx(nLen, false);
+                continue;
+            }
+            if(pdwBytesRead)
+                break;
+            // nothing to read yet, wait for the next data or the timeout
+            if(CVirtualClock::seconds() >= dDeadline)
+                break;
+            if(m_nNext < m_Records.size() && m_Records[m_nNext].nType != TRACE_TX && dueTime(m_nNext) < dDeadline)
+                CVirtualClock::advanceTo(dueTime(m_nNext));
+            else
+                CVirtualClock::advanceTo(dDeadline);
+        }
+        return 0;
+    }
+
+    virtual int writeFile(void* lpBuf, const unsigned long& dwBytesToWrite, unsigned long& pdwBytesWritten)
+    {
+        std::string sCmd((const char *)lpBuf, dwBytesToWrite);
+        size_t i;
+
+        pdwBytesWritten = dwBytesToWrite;
+        m_nBytesTx += dwBytesToWrite;
+        for(i = m_nNext; i < m_Records.size() && m_Records[i].nType != TRACE_TX; i++)
+            ;
+        if(i < m_Records.size() && m_Records[i].sData == sCmd) {
+            // the controller output the plugin didn't read is lost, like it was on the real port
+            while(m_nNext < i)
+                skipRecord();
+            // anchor the trace timeline on this command
+            m_dOffset = CVirtualClock::seconds() - m_Records[m_nNext].dTime;
+            m_nNext++;
+            m_nRxOffset = 0;
+            m_nTxMatched++;
+        }
+        else
+            m_nTxMismatched++;
+        return 0;
+    }
+
+    // next command the plugin hasn't sent yet, and when the host sent it (virtual time)
+    bool nextTx(std::string &sCmd, double &dTime)
+    {
+        size_t i;
+
+        for(i = m_nNext; i < m_Records.size(); i++) {
+            if(m_Records[i].nType == TRACE_TX) {
+                sCmd = m_Records[i].sData;
+                dTime = m_Records[i].dTime + m_dOffset;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // give up on the next command, the plugin didn't send it
+    void skipTx()
+    {
+        while(m_nNext < m_Records.size() && m_Records[m_nNext].nType != TRACE_TX)
+            skipRecord();
+        if(m_nNext < m_Records.size()) {
+            m_nNext++;
+            m_nRxOffset = 0;
+            m_nTxSkipped++;
+        }
+    }
+
+    inline bool atEnd() const { return m_nNext >= m_Records.size(); }
+
+    int     m_nNbOpen;
+    int     m_nTxMatched;
+    int     m_nTxMismatched;
+    int     m_nTxSkipped;
+    int     m_nNbErrors;
+    size_t  m_nBytesRx;
+    size_t  m_nBytesTx;
+    size_t  m_nBytesPurged;
+
+protected:
+    inline double dueTime(size_t nRecord) const { return m_Records[nRecord].dTime + m_dOffset; }
+    inline bool isDue(size_t nRecord) const { return dueTime(nRecord) <= CVirtualClock::seconds(); }
+
+    // received data that can be read now ?
+    inline bool nextRx() const
+    {
+        return m_nNext < m_Records.size() && m_Records[m_nNext].nType == TRACE_RX && isDue(m_nNext);
+    }
+
+    void consumeRx(size_t nLen, bool bPurged)
+    {
+        if(bPurged)
+            m_nBytesPurged += nLen;
+        else
+            m_nBytesRx += nLen;
+        m_nRxOffset += nLen;
+        if(m_nRxOffset >= m_Records[m_nNext].sData.size()) {
+            m_nNext++;
+            m_nRxOffset = 0;
+        }
+    }
+
+    void skipRecord()
+    {
+        if(m_Records[m_nNext].nType == TRACE_RX)
+            m_nBytesPurged += m_Records[m_nNext].sData.size() - m_nRxOffset;
+        m_nNext++;
+        m_nRxOffset = 0;
+    }
+
+    const std::vector<TraceRecord>  &m_Records;
+    bool                            m_bOpen;
+    size_t                          m_nNext;        // next record to replay
+    size_t                          m_nRxOffset;    // bytes already read from m_Records[m_nNext]
+    double                          m_dOffset;      // virtual time - trace time
+};
+
+#endif
@@ -0,0 +1,195 @@
+//
+//  VirtualTime.h
+//
+//  Virtual clock for the replay and simulation tools.
+//  Once installed, every CStopWatch runs on it and the sleeper just moves it forward,
+//  so minutes of dome activity run as fast as the CPU allows.
+//
+//  The thread that installs the clock drives it. Other threads (the plugin I/O thread in async
+//  mode) never move it : they wait in waitForTick() and the sleeper moves the clock in
+//  VIRTUAL_STEP steps, letting them react to each one before the next (lockstep).
+//  A thread that is about to start must be announced with expectThread(), or the driver could
+//  run the whole session before it gets scheduled.
+//
+
+#ifndef __VIRTUAL_TIME__
+#define __VIRTUAL_TIME__
+
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <thread>
+
+#include "../../../licensedinterfaces/sleeperinterface.h"
+
+#include "../StopWatch.h"
+
+#define VIRTUAL_STEP            0.005   // seconds, how far the sleeper moves the clock at a time when other threads wait on it
+#define VIRTUAL_IDLE_MS         20      // real time a waiting thread gives the clock to move before giving up (nobody is driving it)
+#define VIRTUAL_LOCKSTEP_MS     200     // real time the driving thread waits for the others to catch up
+
+class CVirtualClock
+{
+public:
+    // install the virtual clock (starting at 0) as the CStopWatch time source, driven by this thread
+    static void install()
+    {
+        Clock &clock = state();
+        std::lock_guard<std::mutex> lock(clock.mutex);
+
+        clock.dNow = 0.0;
+        clock.driver = std::this_thread::get_id();
+        CStopWatch::timeSource() = &CVirtualClock::seconds;
+    }
+
+    static void uninstall() { CStopWatch::timeSource() = NULL; }
+
+    // a thread that will wait on the clock is being started, hold the clock until it does
+    static void expectThread()
+    {
+        Clock &clock = state();
+        std::lock_guard<std::mutex> lock(clock.mutex);
+
+        clock.nExpected++;
+    }
+
+    static double seconds() { return state().dNow.load(); }
+
+    static void advanceTo(double dSeconds)
+    {
+        Clock &clock = state();
+        std::lock_guard<std::mutex> lock(clock.mutex);
+
+        if(dSeconds > clock.dNow.load()) {
+            clock.dNow = dSeconds;
+            clock.nReady = 0;   // nobody has seen this time yet
+            clock.tick.notify_all();
+        }
+    }
+
+    // move the clock forward. When other threads wait on it, in steps and in lockstep with them.
+    static void advance(double dSeconds)
+    {
+        double dEnd = seconds() + dSeconds;
+        double dNext;
+
+        if(dSeconds <= 0)
+            return;
+        if(!hasWaiters()) {
+            advanceTo(dEnd);
+            return;
+        }
+        while(seconds() < dEnd) {
+            dNext = seconds() + VIRTUAL_STEP;
+            advanceTo(dNext < dEnd ? dNext : dEnd);
+            waitForOthers();
+        }
+    }
+
+    // the calling thread is the one moving the clock
+    static bool isDriver() { return std::this_thread::get_id() == state().driver; }
+
+    // for the other threads : wait until the clock moves past dSeen.
+    // Returns false if it didn't within VIRTUAL_IDLE_MS of real time.
+    static bool waitForTick(double dSeen)
+    {
+        thread_local CWaiter waiter;
+        Clock &clock = state();
+        std::unique_lock<std::mutex> lock(clock.mutex);
+
+        waiter.enroll(clock);
+        if(clock.dNow.load() > dSeen)
+            return true;
+        clock.nReady++;
+        clock.ready.notify_all();
+        while(clock.dNow.load() <= dSeen) {
+            if(clock.tick.wait_for(lock, std::chrono::milliseconds(VIRTUAL_IDLE_MS)) == std::cv_status::timeout && clock.dNow.load() <= dSeen) {
+                clock.nReady--;
+                return false;
+            }
+        }
+        return true;
+    }
+
+protected:
+    typedef struct Clock {
+        Clock() : dNow(0.0), nWaiters(0), nExpected(0), nReady(0) {}
+        std::atomic<double>     dNow;
+        std::thread::id         driver;
+        std::mutex              mutex;
+        std::condition_variable tick;       // the clock moved
+        std::condition_variable ready;      // a waiting thread saw the current time
+        int                     nWaiters;   // threads that wait on the clock
+        int                     nExpected;  // threads announced that haven't waited yet
+        int                     nReady;     // how many of them are waiting for the next tick
+    } Clock;
+
+    // a thread waiting on the clock, counted until it ends
+    class CWaiter
+    {
+    public:
+        CWaiter() : m_pClock(NULL) {}
+        ~CWaiter()
+        {
+            if(!m_pClock)
+                return;
+            std::lock_guard<std::mutex> lock(m_pClock->mutex);
+            m_pClock->nWaiters--;
+            m_pClock->ready.notify_all();
+        }
+        // called with the clock mutex held
+        inline void enroll(Clock &clock)
+        {
+            if(m_pClock)
+                return;
+            m_pClock = &clock;
+            clock.nWaiters++;
+            if(clock.nExpected > 0)
+                clock.nExpected--;
+        }
+    private:
+        Clock *m_pClock;
+    };
+
+    static Clock &state()
+    {
+        static Clock clock;
+        return clock;
+    }
+
+    static bool hasWaiters()
+    {
+        Clock &clock = state();
+        std::lock_guard<std::mutex> lock(clock.mutex);
+        return clock.nWaiters + clock.nExpected > 0;
+    }
+
+    // the waiting threads have all seen the current time, or are busy for too long
+    static void waitForOthers()
+    {
+        Clock &clock = state();
+        std::unique_lock<std::mutex> lock(clock.mutex);
+
+        if(!clock.ready.wait_for(lock, std::chrono::milliseconds(VIRTUAL_LOCKSTEP_MS), [&clock]() { return clock.nExpected == 0 && clock.nReady >= clock.nWaiters; }))
+            clock.nExpected = 0;    // the announced threads aren't coming
+    }
+};
+
+class CVirtualSleeper : public SleeperInterface
+{
+public:
+    CVirtualSleeper() { m_nNbSleeps = 0; m_dTotalSeconds = 0; }
+
+    virtual void sleep(const int& milliSecondsToSleep)
+    {
+        m_nNbSleeps++;
+        m_dTotalSeconds += milliSecondsToSleep / 1000.0;
+        CVirtualClock::advance(milliSecondsToSleep / 1000.0);
+    }
+
+    int     m_nNbSleeps;
+    double  m_dTotalSeconds;
+};
+
+#endif
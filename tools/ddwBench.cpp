@@ -0,0 +1,375 @@
+//
+//  ddwBench.cpp
+//
+//  Latency benchmark of the X2Dome entry points against a simulated controller.
+//
+//  TheSkyX's polling is replayed through the dapi* calls for a number of cycles (goto, open,
+//  close, find home, park, unpark, sync, abort with GetAzEl in between) and every call is timed.
+//  For each entry point the p50/p99/max wall latency, the time the call kept the host waiting
+//  on the link (virtual time with the built-in simulator), the serial bytes exchanged and the
+//  port calls made per call are reported, as text, CSV or JSON to compare plugin builds.
+//
+//  By default the simulator runs in-process in virtual time, so port calls are SerX calls.
+//  With -l the benchmark talks to ddwSim over its PTY in real time and counts system calls.
+//
+//  usage : ddwBench [-n cycles] [-p poll_ms] [-l link] [-a] [-f text|csv|json]
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "../x2dome.h"
+#include "SimSerX.h"
+#include "PosixSerX.h"
+
+#define DEFAULT_CYCLES      10
+#define DEFAULT_POLL_MS     1000
+#define MAX_POLLS           600
+
+enum BenchFormat {FORMAT_TEXT = 0, FORMAT_CSV, FORMAT_JSON};
+
+#pragma mark - host side interfaces
+
+class CBenchMutex : public MutexInterface
+{
+public:
+    virtual void lock() { m_Mutex.lock(); }
+    virtual void unlock() { m_Mutex.unlock(); }
+protected:
+    std::recursive_mutex m_Mutex;
+};
+
+class CBenchSleeper : public SleeperInterface
+{
+public:
+    virtual void sleep(const int& milliSecondsToSleep) { usleep(milliSecondsToSleep * 1000); }
+};
+
+// INI file kept in memory so the benchmark doesn't change the user settings
+class CBenchIniUtil : public BasicIniUtilInterface
+{
+public:
+    virtual int readInt(const char* pszParentKey, const char* pszChildKey, const int nDefault, bool* pbFound = 0)
+    {
+        std::map<std::string, std::string>::iterator it = m_Values.find(key(pszParentKey, pszChildKey));
+        if(pbFound)
+            *pbFound = it != m_Values.end();
+        return it != m_Values.end() ? atoi(it->second.c_str()) : nDefault;
+    }
+
+    virtual int writeInt(const char* pszParentKey, const char* pszChildKey, const int nValue)
+    {
+        m_Values[key(pszParentKey, pszChildKey)] = std::to_string(nValue);
+        return 0;
+    }
+
+    virtual double readDouble(const char* pszParentKey, const char* pszChildKey, const double dDefault, bool* pbFound = 0)
+    {
+        std::map<std::string, std::string>::iterator it = m_Values.find(key(pszParentKey, pszChildKey));
+        if(pbFound)
+            *pbFound = it != m_Values.end();
+        return it != m_Values.end() ? atof(it->second.c_str()) : dDefault;
+    }
+
+    virtual int writeDouble(const char* pszParentKey, const char* pszChildKey, const double dValue)
+    {
+        m_Values[key(pszParentKey, pszChildKey)] = std::to_string(dValue);
+        return 0;
+    }
+
+    virtual void readString(const char* pszParentKey, const char* pszChildKey, const char* pszDefault, char* pszOut, int nOutMaxSize, bool* pbFound = 0)
+    {
+        std::map<std::string, std::string>::iterator it = m_Values.find(key(pszParentKey, pszChildKey));
+        if(pbFound)
+            *pbFound = it != m_Values.end();
+        // pszDefault and pszOut can be the same buffer
+        std::string sValue = it != m_Values.end() ? it->second : std::string(pszDefault);
+        snprintf(pszOut, nOutMaxSize, "%s", sValue.c_str());
+    }
+
+    virtual int writeString(const char* pszParentKey, const char* pszChildKey, const char* pszValue)
+    {
+        m_Values[key(pszParentKey, pszChildKey)] = pszValue;
+        return 0;
+    }
+
+protected:
+    static std::string key(const char *pszParentKey, const char *pszChildKey) { return std::string(pszParentKey) + "/" + pszChildKey; }
+
+    std::map<std::string, std::string> m_Values;
+};
+
+#pragma mark - measurements
+
+typedef struct {
+    std::vector<double> wallUs;     // CPU side latency
+    std::vector<double> linkMs;     // time spent waiting on the dome (virtual time), simulator only
+    unsigned long       nBytes;     // rx + tx
+    unsigned long       nPortCalls;
+    int                 nErrors;
+} CallStats;
+
+static std::map<std::string, CallStats> stats;
+static std::vector<std::string> callOrder;
+
+static std::atomic<unsigned long> *pnPortCalls;
+static std::atomic<unsigned long> *pnBytesRx;
+static std::atomic<unsigned long> *pnBytesTx;
+static bool bVirtual = true;
+
+// time one dapi call and charge it with the serial traffic it generated
+template <typename F> static int timed(const char *pszName, F call)
+{
+    unsigned long nCalls = *pnPortCalls;
+    unsigned long nBytes = *pnBytesRx + *pnBytesTx;
+    double dVirtualStart = bVirtual ? CVirtualClock::seconds() : 0;
+    std::chrono::steady_clock::time_point tStart = std::chrono::steady_clock::now();
+
+    int nErr = call();
+
+    double dWallUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - tStart).count();
+    if(!stats.count(pszName))
+        callOrder.push_back(pszName);
+    CallStats &s = stats[pszName];
+    s.wallUs.push_back(dWallUs);
+    if(bVirtual)
+        s.linkMs.push_back((CVirtualClock::seconds() - dVirtualStart) * 1000.0);
+    s.nBytes += *pnBytesRx + *pnBytesTx - nBytes;
+    s.nPortCalls += *pnPortCalls - nCalls;
+    if(nErr)
+        s.nErrors++;
+    return nErr;
+}
+
+// nearest rank percentile
+static double percentile(std::vector<double> values, double dPercent)
+{
+    size_t nRank;
+
+    if(values.empty())
+        return 0;
+    std::sort(values.begin(), values.end());
+    nRank = (size_t)ceil(dPercent / 100.0 * values.size());
+    return values[nRank ? nRank - 1 : 0];
+}
+
+#pragma mark - host behaviour
+
+static X2Dome *pDome;
+static SleeperInterface *pSleeper;
+static int nPollMs = DEFAULT_POLL_MS;
+
+static void getAzEl()
+{
+    double dAz, dEl;
+    timed("dapiGetAzEl", [&]() { return pDome->dapiGetAzEl(&dAz, &dEl); });
+}
+
+// what TheSkyX does while waiting on an operation : GetAzEl and IsXXXComplete every poll
+template <typename F> static void waitFor(const char *pszName, F isComplete)
+{
+    bool bComplete = false;
+    int nPolls = 0;
+    int nErr = 0;
+
+    while(!bComplete && !nErr && nPolls++ < MAX_POLLS) {
+        pSleeper->sleep(nPollMs);
+        getAzEl();
+        nErr = timed(pszName, [&]() { return isComplete(&bComplete); });
+    }
+}
+
+static void runCycle(int nCycle)
+{
+    double dAz = fmod(60.0 + nCycle * 97.0, 360.0);
+    double dEl;
+
+    timed("dapiGotoAzEl", [&]() { return pDome->dapiGotoAzEl(dAz, 0); });
+    waitFor("dapiIsGotoComplete", [&](bool *pb) { return pDome->dapiIsGotoComplete(pb); });
+
+    timed("dapiOpen", [&]() { return pDome->dapiOpen(); });
+    waitFor("dapiIsOpenComplete", [&](bool *pb) { return pDome->dapiIsOpenComplete(pb); });
+    timed("dapiClose", [&]() { return pDome->dapiClose(); });
+    waitFor("dapiIsCloseComplete", [&](bool *pb) { return pDome->dapiIsCloseComplete(pb); });
+
+    // start a slew and abort it
+    timed("dapiGotoAzEl", [&]() { return pDome->dapiGotoAzEl(fmod(dAz + 180.0, 360.0), 0); });
+    pSleeper->sleep(nPollMs);
+    getAzEl();
+    timed("dapiAbort", [&]() { return pDome->dapiAbort(); });
+    pSleeper->sleep(nPollMs * 5);
+
+    timed("dapiFindHome", [&]() { return pDome->dapiFindHome(); });
+    waitFor("dapiIsFindHomeComplete", [&](bool *pb) { return pDome->dapiIsFindHomeComplete(pb); });
+    pDome->dapiGetAzEl(&dAz, &dEl);
+    timed("dapiSync", [&]() { return pDome->dapiSync(dAz, dEl); });
+
+    timed("dapiPark", [&]() { return pDome->dapiPark(); });
+    waitFor("dapiIsParkComplete", [&](bool *pb) { return pDome->dapiIsParkComplete(pb); });
+    timed("dapiUnpark", [&]() { return pDome->dapiUnpark(); });
+    waitFor("dapiIsUnparkComplete", [&](bool *pb) { return pDome->dapiIsUnparkComplete(pb); });
+
+    // idle polling
+    for(int i = 0; i < 10; i++) {
+        pSleeper->sleep(nPollMs);
+        getAzEl();
+    }
+}
+
+#pragma mark - output
+
+static void printResults(int nFormat, const char *pszBackend, int nCycles)
+{
+    size_t i;
+    const char *pszSep = "";
+
+    if(nFormat == FORMAT_JSON)
+        printf("{\n  \"driver_version\": %.2f,\n  \"backend\": \"%s\",\n  \"cycles\": %d,\n  \"poll_ms\": %d,\n  \"calls\": [\n",
+               DRIVER_VERSION, pszBackend, nCycles, nPollMs);
+    else if(nFormat == FORMAT_CSV)
+        printf("driver_version,backend,call,count,errors,wall_p50_us,wall_p99_us,wall_max_us,link_p50_ms,link_p99_ms,link_max_ms,bytes_per_call,port_calls_per_call\n");
+    else
+        printf("driver %.2f, %s backend, %d cycles, %d ms poll\n%-24s %6s %4s %10s %10s %10s %9s %9s %9s %7s %7s\n",
+               DRIVER_VERSION, pszBackend, nCycles, nPollMs,
+               "call", "count", "err", "p50 us", "p99 us", "max us", "link p50", "link p99", "link max", "bytes", "calls");
+
+    for(i = 0; i < callOrder.size(); i++) {
+        CallStats &s = stats[callOrder[i]];
+        double dCount = (double)s.wallUs.size();
+        double dLinkMax = s.linkMs.empty() ? 0 : *std::max_element(s.linkMs.begin(), s.linkMs.end());
+
+        switch(nFormat) {
+            case FORMAT_JSON :
+                printf("%s    {\"call\": \"%s\", \"count\": %zu, \"errors\": %d, "
+                       "\"wall_us\": {\"p50\": %.3f, \"p99\": %.3f, \"max\": %.3f}, "
+                       "\"link_ms\": {\"p50\": %.3f, \"p99\": %.3f, \"max\": %.3f}, "
+                       "\"bytes_per_call\": %.2f, \"port_calls_per_call\": %.2f}",
+                       pszSep, callOrder[i].c_str(), s.wallUs.size(), s.nErrors,
+                       percentile(s.wallUs, 50), percentile(s.wallUs, 99), percentile(s.wallUs, 100),
+                       percentile(s.linkMs, 50), percentile(s.linkMs, 99), dLinkMax,
+                       s.nBytes / dCount, s.nPortCalls / dCount);
+                pszSep = ",\n";
+                break;
+            case FORMAT_CSV :
+                printf("%.2f,%s,%s,%zu,%d,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.2f,%.2f\n",
+                       DRIVER_VERSION, pszBackend, callOrder[i].c_str(), s.wallUs.size(), s.nErrors,
+                       percentile(s.wallUs, 50), percentile(s.wallUs, 99), percentile(s.wallUs, 100),
+                       percentile(s.linkMs, 50), percentile(s.linkMs, 99), dLinkMax,
+                       s.nBytes / dCount, s.nPortCalls / dCount);
+                break;
+            default :
+                printf("%-24s %6zu %4d %10.2f %10.2f %10.2f %9.1f %9.1f %9.1f %7.1f %7.2f\n",
+                       callOrder[i].c_str(), s.wallUs.size(), s.nErrors,
+                       percentile(s.wallUs, 50), percentile(s.wallUs, 99), percentile(s.wallUs, 100),
+                       percentile(s.linkMs, 50), percentile(s.linkMs, 99), dLinkMax,
+                       s.nBytes / dCount, s.nPortCalls / dCount);
+                break;
+        }
+    }
+    if(nFormat == FORMAT_JSON)
+        printf("\n  ]\n}\n");
+}
+
+static void usage(const char *pszName)
+{
+    fprintf(stderr, "usage : %s [-n cycles] [-p poll_ms] [-l link] [-a] [-f text|csv|json]\n"
+                    "  -n : number of host cycles (default %d)\n"
+                    "  -p : host poll interval in ms (default %d)\n"
+                    "  -l : use ddwSim on this PTY in real time instead of the in-process simulator\n"
+                    "  -a : enable the asynchronous I/O thread\n"
+                    "  -f : output format\n", pszName, DEFAULT_CYCLES, DEFAULT_POLL_MS);
+}
+
+int main(int argc, char **argv)
+{
+    CDomeSimulator sim;
+    CBenchIniUtil *pIni = new CBenchIniUtil();
+    SerXInterface *pSerX;
+    const char *pszLink = NULL;
+    int nCycles = DEFAULT_CYCLES;
+    int nFormat = FORMAT_TEXT;
+    bool bAsync = false;
+    int nOpt;
+    int nErr;
+    int i;
+
+    while((nOpt = getopt(argc, argv, "n:p:l:af:")) != -1) {
+        switch(nOpt) {
+            case 'n' :  nCycles = atoi(optarg); break;
+            case 'p' :  nPollMs = atoi(optarg); break;
+            case 'l' :  pszLink = optarg; break;
+            case 'a' :  pIni->writeInt(PARENT_KEY, CHILD_KEY_ASYNC_IO, 1); bAsync = true; break;
+            case 'f' :
+                if(!strcmp(optarg, "csv"))
+                    nFormat = FORMAT_CSV;
+                else if(!strcmp(optarg, "json"))
+                    nFormat = FORMAT_JSON;
+                else if(!strcmp(optarg, "text"))
+                    nFormat = FORMAT_TEXT;
+                else {
+                    usage(argv[0]);
+                    return 1;
+                }
+                break;
+            default :
+                usage(argv[0]);
+                return 1;
+        }
+    }
+
+    if(pszLink) {
+        CPosixSerX *pPosixSerX = new CPosixSerX();
+        bVirtual = false;
+        pnPortCalls = &pPosixSerX->m_nSyscalls;
+        pnBytesRx = &pPosixSerX->m_nBytesRx;
+        pnBytesTx = &pPosixSerX->m_nBytesTx;
+        pSerX = pPosixSerX;
+        pSleeper = new CBenchSleeper();
+        pIni->writeString(PARENT_KEY, CHILD_KEY_PORTNAME, pszLink);
+    }
+    else {
+        CVirtualClock::install();
+        if(bAsync)
+            CVirtualClock::expectThread();  // the plugin I/O thread, started by establishLink
+        CSimSerX *pSimSerX = new CSimSerX(sim);
+        pSimSerX->setLatency(0.010);
+        pnPortCalls = &pSimSerX->m_nCalls;
+        pnBytesRx = &pSimSerX->m_nBytesRx;
+        pnBytesTx = &pSimSerX->m_nBytesTx;
+        pSerX = pSimSerX;
+        pSleeper = new CVirtualSleeper();
+        pIni->writeString(PARENT_KEY, CHILD_KEY_PORTNAME, "sim");
+    }
+
+    // X2Dome owns the interfaces, like in TheSkyX
+    pDome = new X2Dome("ddwBench", 0, pSerX, NULL, pSleeper, pIni, NULL, new CBenchMutex(), NULL);
+
+    nErr = timed("establishLink", [&]() { return pDome->establishLink(); });
+    if(nErr) {
+        fprintf(stderr, "can't connect : %d\n", nErr);
+        delete pDome;
+        return 1;
+    }
+
+    for(i = 0; i < nCycles; i++)
+        runCycle(i);
+
+    timed("terminateLink", [&]() { return pDome->terminateLink(); });
+    printResults(nFormat, pszLink ? "pty" : "sim", nCycles);
+
+    delete pDome;
+    if(!pszLink)
+        CVirtualClock::uninstall();
+    return 0;
+}
@@ -0,0 +1,350 @@
+//
+//  ddwMicroBench.cpp
+//
+//  Microbenchmarks of the per poll protocol work of CddwDome : INF record parsing (V1 and V4
+//  firmware), the stream decoder on motion messages, the message handling in isDomeMoving and
+//  the log path. Reports ns/op and heap allocations/op (operator new calls).
+//
+//  The built-in corpus holds INF records as sent by V1 and V4 controllers, -c replaces it with
+//  a file of records, one per line (for example extracted from a serial trace).
+//
+//  usage : ddwMicroBench [-t min_ms] [-c corpus_file] [-f text|csv|json]
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "../ddwDome.h"
+#include "VirtualTime.h"
+
+#define DEFAULT_MIN_MS      200
+#define LOG_BATCH           512     // stay well under the logger ring size between writer passes
+
+enum BenchFormat {FORMAT_TEXT = 0, FORMAT_CSV, FORMAT_JSON};
+
+#pragma mark - allocation counting
+
+static std::atomic<unsigned long> nAllocs(0);
+
+void *operator new(size_t nSize)
+{
+    void *p;
+
+    nAllocs.fetch_add(1, std::memory_order_relaxed);
+    p = malloc(nSize ? nSize : 1);
+    if(!p)
+        throw std::bad_alloc();
+    return p;
+}
+
+void *operator new[](size_t nSize) { return operator new(nSize); }
+void operator delete(void *p) noexcept { free(p); }
+void operator delete[](void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+void operator delete[](void *p, size_t) noexcept { free(p); }
+
+#pragma mark - corpus
+
+static const char *V1Corpus[] = {
+    "V1,701,527,4,526,0,1,1,0\r",
+    "V1,701,527,4,131,0,2,1,1\r",
+    "V1,701,527,4,0,0,1,1,1\r",
+    "V1,701,527,4,700,0,0,1,1\r",
+    "V1,391,124,2,124,0,1,1,0\r",
+    "V1,391,124,2,87,0,2,1,1\r\n",
+};
+
+static const char *V4Corpus[] = {
+    "V4,701,527,4,526,0,1,1,0,522,532,0,128,255,255,255,255,255,255,255,999,5,0\r",
+    "V4,701,527,4,233,0,2,1,1,522,532,0,128,255,255,255,255,255,255,255,999,5,0\r",
+    "V4,701,527,4,0,0,1,1,1,522,532,0,128,255,255,255,255,255,255,255,999,5,0\r",
+    "V4,701,527,4,612,0,0,1,1,522,532,0,128,255,255,255,255,255,255,255,999,5,0\r",
+    "V4,391,124,2,124,0,1,1,0,120,128,1,128,255,0,255,255,255,255,255,999,3,0\r",
+    "V4,391,124,2,300,0,2,1,1,120,128,1,128,255,0,255,255,255,255,255,999,3,0\r\n",
+};
+
+#define NB_ITEMS(a) (sizeof(a) / sizeof((a)[0]))
+
+#pragma mark - plugin access
+
+// SerX handing out whatever was fed to it, without allocating
+class CFeedSerX : public SerXInterface
+{
+public:
+    CFeedSerX() { m_nLen = 0; }
+
+    void feed(const char *pszData)
+    {
+        size_t nLen = strlen(pszData);
+        if(m_nLen + nLen > sizeof(m_szData))
+            m_nLen = 0;
+        memcpy(m_szData + m_nLen, pszData, nLen);
+        m_nLen += nLen;
+    }
+
+    virtual int open(const char* /*pszPort*/, const unsigned long& /*dwBaudRate*/ = 9600, const Parity& /*parity*/ = B_NOPARITY, const char* /*pszSession*/ = 0) { return 0; }
+    virtual int close() { return 0; }
+    virtual bool isConnected() const { return true; }
+    virtual int flushTx() { return 0; }
+    virtual int purgeTxRx() { m_nLen = 0; return 0; }
+    virtual int bytesWaitingRx(int &nBytesWaitingRx) { nBytesWaitingRx = (int)m_nLen; return 0; }
+
+    virtual int readFile(void* lpBuf, const unsigned long dwBytesToRead, unsigned long& pdwBytesRead, const unsigned long& /*dwTimeOutMs*/ = 1000)
+    {
+        pdwBytesRead = dwBytesToRead < m_nLen ? dwBytesToRead : m_nLen;
+        memcpy(lpBuf, m_szData, pdwBytesRead);
+        memmove(m_szData, m_szData + pdwBytesRead, m_nLen - pdwBytesRead);
+        m_nLen -= pdwBytesRead;
+        return 0;
+    }
+
+    virtual int writeFile(void* /*lpBuf*/, const unsigned long& dwBytesToWrite, unsigned long& pdwBytesWritten)
+    {
+        pdwBytesWritten = dwBytesToWrite;
+        return 0;
+    }
+
+protected:
+    char    m_szData[1024];
+    size_t  m_nLen;
+};
+
+class CBenchDome : public CddwDome
+{
+public:
+    CBenchDome(CFeedSerX &serx) : m_Serx(serx)
+    {
+        SetSerxPointer(&serx);
+        m_bIsConnected = true;
+    }
+
+    inline int parseInf(const char *pszInf) { return parseGINF(pszInf); }
+
+    // one poll of a moving dome receiving pszMsg
+    inline bool classify(const char *pszMsg)
+    {
+        m_Serx.feed(pszMsg);
+        m_bDomeIsMoving = true;
+        return isDomeMoving();
+    }
+
+    // a typical verbose trace line
+    inline void logLine(double dAz)
+    {
+        DDW_LOG(DDW_LOG_VERBOSE, "[CddwDome::isDomeMoving] resp[0] is 'P' we're still moving and updating position, az = %3.2f\n", dAz);
+    }
+
+    inline unsigned int droppedLogs() const { return m_Logger.dropped(); }
+
+protected:
+    CFeedSerX   &m_Serx;
+};
+
+#pragma mark - runner
+
+typedef struct {
+    std::string     sName;
+    unsigned long   nOps;
+    double          dNsPerOp;
+    double          dAllocsPerOp;
+} BenchResult;
+
+static std::vector<BenchResult> results;
+static int nMinMs = DEFAULT_MIN_MS;
+static volatile int nSink;      // keeps the results alive
+
+// run op(i) in growing batches until the total time reaches nMinMs
+template <typename F> static void bench(const char *pszName, F op)
+{
+    unsigned long nBatch = 64;
+    unsigned long nOps = 0;
+    unsigned long nAllocStart;
+    unsigned long i;
+    double dNs = 0;
+    BenchResult result;
+
+    for(i = 0; i < nBatch; i++)     // warm up
+        op(i);
+
+    nAllocStart = nAllocs.load(std::memory_order_relaxed);
+    while(dNs < nMinMs * 1e6) {
+        std::chrono::steady_clock::time_point tStart = std::chrono::steady_clock::now();
+        for(i = 0; i < nBatch; i++)
+            op(nOps + i);
+        dNs += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - tStart).count();
+        nOps += nBatch;
+        if(nBatch < (1UL << 20))
+            nBatch *= 2;
+    }
+
+    result.sName = pszName;
+    result.nOps = nOps;
+    result.dNsPerOp = dNs / nOps;
+    result.dAllocsPerOp = double(nAllocs.load(std::memory_order_relaxed) - nAllocStart) / nOps;
+    results.push_back(result);
+}
+
+// same, with pause() called untimed between batches of nBatch ops
+template <typename F, typename P> static void benchPaced(const char *pszName, unsigned long nBatch, F op, P pause)
+{
+    unsigned long nOps = 0;
+    unsigned long nAllocStart;
+    unsigned long i;
+    double dNs = 0;
+    BenchResult result;
+
+    nAllocStart = nAllocs.load(std::memory_order_relaxed);
+    while(dNs < nMinMs * 1e6 / 10 || nOps < 8 * nBatch) {
+        std::chrono::steady_clock::time_point tStart = std::chrono::steady_clock::now();
+        for(i = 0; i < nBatch; i++)
+            op(nOps + i);
+        dNs += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - tStart).count();
+        nOps += nBatch;
+        pause();
+    }
+
+    result.sName = pszName;
+    result.nOps = nOps;
+    result.dNsPerOp = dNs / nOps;
+    result.dAllocsPerOp = double(nAllocs.load(std::memory_order_relaxed) - nAllocStart) / nOps;
+    results.push_back(result);
+}
+
+static bool loadCorpus(const char *pszPath, std::vector<std::string> &v1, std::vector<std::string> &v4)
+{
+    FILE *pFile = fopen(pszPath, "r");
+    char szLine[256];
+
+    if(!pFile)
+        return false;
+    v1.clear();
+    v4.clear();
+    while(fgets(szLine, sizeof(szLine), pFile)) {
+        if(!strncmp(szLine, "V1,", 3))
+            v1.push_back(szLine);
+        else if(szLine[0] == 'V')
+            v4.push_back(szLine);
+    }
+    fclose(pFile);
+    return true;
+}
+
+static void printResults(int nFormat)
+{
+    size_t i;
+
+    if(nFormat == FORMAT_JSON)
+        printf("{\n  \"benchmarks\": [\n");
+    else if(nFormat == FORMAT_CSV)
+        printf("benchmark,ops,ns_per_op,allocs_per_op\n");
+    else
+        printf("%-28s %12s %10s %10s\n", "benchmark", "ops", "ns/op", "allocs/op");
+
+    for(i = 0; i < results.size(); i++) {
+        BenchResult &r = results[i];
+        switch(nFormat) {
+            case FORMAT_JSON :
+                printf("    {\"benchmark\": \"%s\", \"ops\": %lu, \"ns_per_op\": %.2f, \"allocs_per_op\": %.4f}%s\n",
+                       r.sName.c_str(), r.nOps, r.dNsPerOp, r.dAllocsPerOp, i + 1 < results.size() ? "," : "");
+                break;
+            case FORMAT_CSV :
+                printf("%s,%lu,%.2f,%.4f\n", r.sName.c_str(), r.nOps, r.dNsPerOp, r.dAllocsPerOp);
+                break;
+            default :
+                printf("%-28s %12lu %10.2f %10.4f\n", r.sName.c_str(), r.nOps, r.dNsPerOp, r.dAllocsPerOp);
+                break;
+        }
+    }
+    if(nFormat == FORMAT_JSON)
+        printf("  ]\n}\n");
+}
+
+int main(int argc, char **argv)
+{
+    std::vector<std::string> v1(V1Corpus, V1Corpus + NB_ITEMS(V1Corpus));
+    std::vector<std::string> v4(V4Corpus, V4Corpus + NB_ITEMS(V4Corpus));
+    int nFormat = FORMAT_TEXT;
+    int nOpt;
+
+    while((nOpt = getopt(argc, argv, "t:c:f:")) != -1) {
+        switch(nOpt) {
+            case 't' :  nMinMs = atoi(optarg); break;
+            case 'c' :
+                if(!loadCorpus(optarg, v1, v4)) {
+                    fprintf(stderr, "can't read %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'f' :
+                if(!strcmp(optarg, "csv"))
+                    nFormat = FORMAT_CSV;
+                else if(!strcmp(optarg, "json"))
+                    nFormat = FORMAT_JSON;
+                break;
+            default :
+                fprintf(stderr, "usage : %s [-t min_ms] [-c corpus_file] [-f text|csv|json]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    // the dome logs to $HOME, don't overwrite the plugin log
+    setenv("HOME", "/tmp", 1);
+    // a frozen clock keeps the INF refresh timer from sending anything during the classification
+    CVirtualClock::install();
+    CFeedSerX serx;
+    CBenchDome dome(serx);
+    CLogClock logClock;
+    char szTime[64];
+    CStreamDecoder decoder;
+    DdwEvent event;
+    const char *pszStream = "R\rP0345\rTTP0346\r";
+    unsigned int nStreamLen = strlen(pszStream);
+
+    // parse the whole corpus once so a bad record doesn't go unnoticed
+    for(size_t i = 0; i < v1.size(); i++)
+        if(dome.parseInf(v1[i].c_str()))
+            fprintf(stderr, "warning : can't parse %s", v1[i].c_str());
+    for(size_t i = 0; i < v4.size(); i++)
+        if(dome.parseInf(v4[i].c_str()))
+            fprintf(stderr, "warning : can't parse %s", v4[i].c_str());
+
+    if(!v1.empty())
+        bench("parseGINF/V1", [&](unsigned long i) { nSink = dome.parseInf(v1[i % v1.size()].c_str()); });
+    if(!v4.empty())
+        bench("parseGINF/V4", [&](unsigned long i) { nSink = dome.parseInf(v4[i % v4.size()].c_str()); });
+    bench("decode/P", [&](unsigned long /*i*/) { decoder.decode("P0345\r", 6, event); nSink = event.nTicks; });
+    bench("decode/stream", [&](unsigned long /*i*/) {
+        for(unsigned int nPos = 0; nPos < nStreamLen; )
+            nPos += decoder.decode(pszStream + nPos, nStreamLen - nPos, event);
+        nSink = event.nType;
+    });
+
+    // leave the dome with a valid V4 record for the classification
+    dome.parseInf(V4Corpus[0]);
+    bench("isDomeMoving/P", [&](unsigned long /*i*/) { nSink = dome.classify("P0345\r"); });
+    bench("isDomeMoving/R", [&](unsigned long /*i*/) { nSink = dome.classify("R\r"); });
+    bench("isDomeMoving/O", [&](unsigned long /*i*/) { nSink = dome.classify("O\r"); });
+    bench("isDomeMoving/P+R", [&](unsigned long /*i*/) { nSink = dome.classify("R\rP0345\rP0346\r"); });
+    bench("isDomeMoving/V", [&](unsigned long /*i*/) { nSink = dome.classify(V4Corpus[0]); });
+
+    // logging : disabled (the normal case), then copying the arguments into the ring with the writer running
+    bench("log/off", [&](unsigned long i) { dome.logLine(i * 0.1); });
+    bench("log/timestamp", [&](unsigned long i) { nSink = logClock.format(CLogClock::nowUs() + i * 1000, szTime, sizeof(szTime)); });
+    dome.setLogLevel(DDW_LOG_VERBOSE);
+    benchPaced("log/verbose", LOG_BATCH, [&](unsigned long i) { dome.logLine(i * 0.1); }, []() { usleep(150000); });
+    if(dome.droppedLogs())
+        fprintf(stderr, "warning : %u log records dropped during the benchmark\n", dome.droppedLogs());
+    dome.setLogLevel(DDW_LOG_OFF);
+
+    printResults(nFormat);
+    CVirtualClock::uninstall();
+    return 0;
+}
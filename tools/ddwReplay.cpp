@@ -0,0 +1,198 @@
+//
+//  ddwReplay.cpp
+//
+//  Replays a serial trace (X2_DDWTrace.bin) through CddwDome in virtual time.
+//
+//  The host calls are rebuilt from the commands found in the trace : each command the plugin
+//  doesn't send by itself is issued through the matching CddwDome call at the time TheSkyX
+//  issued it, then the matching isXXXComplete is polled like the host does until the operation
+//  completes or the host moved on to something else.
+//
+//  usage : ddwReplay [-s session] [-p poll_ms] [-v] trace_file
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+
+#include <chrono>
+
+#include "../ddwDome.h"
+#include "TraceReplay.h"
+
+#define DEFAULT_POLL_MS     1000
+#define MAX_POLL_SECONDS    300
+
+enum ReplayOperation {OP_NONE = 0, OP_GOTO, OP_HOME, OP_OPEN, OP_CLOSE, OP_CALIBRATE};
+
+static bool bVerbose = false;
+
+// CddwDome with access to the internals we need to replay a plain GINF poll
+class CReplayDome : public CddwDome
+{
+public:
+    int pollInf() { return getInfRecord(true); }
+};
+
+static int startOperation(CReplayDome &dome, const std::string &sCmd, int &nOperation)
+{
+    int nAz;
+
+    nOperation = OP_NONE;
+    if(sCmd == "GINF")
+        return dome.pollInf();
+    if(sCmd.compare(0, 4, "STOP") == 0)
+        return dome.abortCurrentCommand();
+    if(sCmd == "GHOM") {
+        nOperation = OP_HOME;
+        return dome.goHome();
+    }
+    if(sCmd == "GOPN") {
+        nOperation = OP_OPEN;
+        return dome.openShutter();
+    }
+    if(sCmd == "GCLS") {
+        nOperation = OP_CLOSE;
+        return dome.closeShutter();
+    }
+    if(sCmd == "GTRN") {
+        nOperation = OP_CALIBRATE;
+        return dome.calibrate();
+    }
+    if(sCmd.size() == 4 && sCmd[0] == 'G' && sscanf(sCmd.c_str() + 1, "%3d", &nAz) == 1) {
+        nOperation = OP_GOTO;
+        return dome.gotoAzimuth(nAz);
+    }
+    return -1;
+}
+
+static int pollOperation(CReplayDome &dome, int nOperation, bool &bComplete)
+{
+    switch(nOperation) {
+        case OP_GOTO :      return dome.isGoToComplete(bComplete);
+        case OP_HOME :      return dome.isFindHomeComplete(bComplete);
+        case OP_OPEN :      return dome.isOpenComplete(bComplete);
+        case OP_CLOSE :     return dome.isCloseComplete(bComplete);
+        case OP_CALIBRATE : return dome.isCalibratingComplete(bComplete);
+        default :
+            bComplete = true;
+            return 0;
+    }
+}
+
+static void printCmd(const std::string &sCmd)
+{
+    size_t i;
+    for(i = 0; i < sCmd.size(); i++)
+        putchar(isprint((unsigned char)sCmd[i]) ? sCmd[i] : '.');
+}
+
+int main(int argc, char **argv)
+{
+    CTraceReader trace;
+    CVirtualSleeper sleeper;
+    CReplayDome dome;
+    std::string sCmd;
+    double dCmdTime;
+    double dNextTime;
+    int nSession = 0;
+    int nPollMs = DEFAULT_POLL_MS;
+    int nOperation;
+    int nNbCommands = 0;
+    int nMatched;
+    int nSleepMs;
+    int nErr;
+    int nOpt;
+    bool bComplete;
+
+    while((nOpt = getopt(argc, argv, "s:p:v")) != -1) {
+        switch(nOpt) {
+            case 's' :  nSession = atoi(optarg); break;
+            case 'p' :  nPollMs = atoi(optarg); break;
+            case 'v' :  bVerbose = true; break;
+            default :
+                fprintf(stderr, "usage : %s [-s session] [-p poll_ms] [-v] trace_file\n", argv[0]);
+                return 1;
+        }
+    }
+    if(optind >= argc) {
+        fprintf(stderr, "usage : %s [-s session] [-p poll_ms] [-v] trace_file\n", argv[0]);
+        return 1;
+    }
+    if(!trace.load(argv[optind], nSession)) {
+        fprintf(stderr, "can't load session %d from %s\n", nSession, argv[optind]);
+        return 1;
+    }
+
+    CVirtualClock::install();
+    CReplaySerX serx(trace.m_Records);
+    dome.SetSerxPointer(&serx);
+    dome.setSleeper(&sleeper);
+
+    std::chrono::steady_clock::time_point tStart = std::chrono::steady_clock::now();
+
+    nErr = dome.Connect("replay");
+    if(bVerbose)
+        printf("%10.3f Connect -> %d\n", CVirtualClock::seconds(), nErr);
+
+    while(!serx.atEnd() && serx.nextTx(sCmd, dCmdTime)) {
+        CVirtualClock::advanceTo(dCmdTime);
+        nMatched = serx.m_nTxMatched;
+        nErr = startOperation(dome, sCmd, nOperation);
+        nNbCommands++;
+        if(bVerbose) {
+            printf("%10.3f ", CVirtualClock::seconds());
+            printCmd(sCmd);
+            printf(" -> %d\n", nErr);
+        }
+        if(serx.m_nTxMatched == nMatched) {
+            // the plugin didn't send what the host asked in the field, don't get stuck on it
+            serx.skipTx();
+            if(bVerbose)
+                printf("%10.3f   command not sent, skipped\n", CVirtualClock::seconds());
+            continue;
+        }
+
+        // poll until done or until the host sent its next command
+        bComplete = (nOperation == OP_NONE || nErr);
+        while(!bComplete && CVirtualClock::seconds() < dCmdTime + MAX_POLL_SECONDS) {
+            nSleepMs = nPollMs;
+            if(serx.nextTx(sCmd, dNextTime)) {
+                if(dNextTime <= CVirtualClock::seconds())
+                    break;
+                // last poll right when the host moved on
+                if(dNextTime < CVirtualClock::seconds() + nPollMs / 1000.0)
+                    nSleepMs = (int)ceil((dNextTime - CVirtualClock::seconds()) * 1000.0);
+            }
+            sleeper.sleep(nSleepMs);
+            nErr = pollOperation(dome, nOperation, bComplete);
+            if(nErr)
+                break;
+        }
+        if(bVerbose && nOperation != OP_NONE)
+            printf("%10.3f   %s (err %d) az = %3.2f\n", CVirtualClock::seconds(), bComplete ? "complete" : "pending", nErr, dome.getCurrentAz());
+    }
+
+    std::chrono::steady_clock::time_point tEnd = std::chrono::steady_clock::now();
+
+    printf("session           : %d of %d\n", nSession, trace.m_nNbSessions);
+    printf("records           : %zu\n", trace.m_Records.size());
+    printf("host commands     : %d\n", nNbCommands);
+    printf("tx matched        : %d\n", serx.m_nTxMatched);
+    printf("tx mismatched     : %d\n", serx.m_nTxMismatched);
+    printf("tx skipped        : %d\n", serx.m_nTxSkipped);
+    printf("rx bytes read     : %zu\n", serx.m_nBytesRx);
+    printf("rx bytes dropped  : %zu\n", serx.m_nBytesPurged);
+    printf("read errors       : %d\n", serx.m_nNbErrors);
+    printf("port opens        : %d\n", serx.m_nNbOpen);
+    printf("final az          : %3.2f\n", dome.getCurrentAz());
+    printf("shutter state     : %d\n", dome.getCurrentShutterState());
+    printf("virtual time (s)  : %.3f\n", CVirtualClock::seconds());
+    printf("wall time (ms)    : %.3f\n", std::chrono::duration<double, std::milli>(tEnd - tStart).count());
+
+    dome.Disconnect();
+    CVirtualClock::uninstall();
+    return serx.m_nTxMismatched || serx.m_nTxSkipped ? 2 : 0;
+}
@@ -0,0 +1,174 @@
+//
+//  ddwScenario.cpp
+//
+//  Runs a full night sequence (Connect with home resync, a goto refused during the resync, goto,
+//  open, close, an aborted slew, find home, find home again after losing count on the home sensor,
+//  park, then the host polling the parked dome) against the simulated controller in virtual time
+//  and reports how long each step took for the dome (virtual seconds), for the CPU (wall clock)
+//  and the serial traffic. -s runs it with the plugin I/O thread.
+//
+//  usage : ddwScenario [-p poll_ms] [-a az] [-e count_error_ticks] [-i idle_seconds] [-s] [-v]
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <math.h>
+
+#include <chrono>
+
+#include "../ddwDome.h"
+#include "SimSerX.h"
+
+#define DEFAULT_POLL_MS     1000
+#define MAX_STEP_SECONDS    600
+#define DEFAULT_IDLE_SECONDS    600
+
+typedef int (CddwDome::*CompleteFunc)(bool &bComplete);
+
+static CVirtualSleeper sleeper;
+static int nPollMs = DEFAULT_POLL_MS;
+static int nFailures = 0;
+
+static void report(const char *pszStep, int nErr, bool bComplete, double dVirtualStart,
+                   std::chrono::steady_clock::time_point tWallStart, CddwDome &dome, CSimSerX &serx)
+{
+    double dWallMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - tWallStart).count();
+
+    printf("%-10s err %3d %-10s virtual %8.3f s  wall %8.3f ms  az %6.2f  shutter %d  port calls %5lu  tx %5lu  rx %6lu\n",
+           pszStep, nErr, bComplete ? "complete" : "incomplete",
+           CVirtualClock::seconds() - dVirtualStart, dWallMs,
+           dome.getCurrentAz(), dome.getCurrentShutterState(), serx.m_nCalls.load(), serx.m_nBytesTx.load(), serx.m_nBytesRx.load());
+    if(nErr || !bComplete)
+        nFailures++;
+    serx.resetCounters();
+}
+
+// start a command and poll its completion like TheSkyX does
+static void step(const char *pszStep, int nErr, CompleteFunc pfnComplete, CddwDome &dome, CSimSerX &serx)
+{
+    double dStart = CVirtualClock::seconds();
+    std::chrono::steady_clock::time_point tStart = std::chrono::steady_clock::now();
+    bool bComplete = false;
+
+    while(!nErr && !bComplete && CVirtualClock::seconds() - dStart < MAX_STEP_SECONDS) {
+        sleeper.sleep(nPollMs);
+        nErr = (dome.*pfnComplete)(bComplete);
+    }
+    report(pszStep, nErr, bComplete, dStart, tStart, dome, serx);
+}
+
+// abort a slew and leave the port alone for a while before finding home, like ddwBench does.
+// The dome stopped long before the host asks, goHome must see it.
+static void abortThenHome(double dAz, CddwDome &dome, CSimSerX &serx)
+{
+    double dStart = CVirtualClock::seconds();
+    std::chrono::steady_clock::time_point tStart = std::chrono::steady_clock::now();
+    int nErr;
+
+    nErr = dome.gotoAzimuth(fmod(dAz + 180.0, 360.0));
+    sleeper.sleep(nPollMs);
+    if(!nErr)
+        nErr = dome.abortCurrentCommand();
+    report("abort", nErr, true, dStart, tStart, dome, serx);
+    sleeper.sleep(nPollMs * 5);
+    step("home", dome.goHome(), &CddwDome::isFindHomeComplete, dome, serx);
+}
+
+// the controller lost count while on the home sensor : goHome finds it already home with the
+// wrong position and has to move off and back for the count to be corrected.
+static void rehome(int nCountError, CDomeSimulator &sim, CddwDome &dome, CSimSerX &serx)
+{
+    DomeSimConfig config = sim.config();
+
+    sim.reset(config, config.nHomeTicks + nCountError);
+    sim.setCountError(nCountError);
+    step("rehome", dome.goHome(), &CddwDome::isFindHomeComplete, dome, serx);
+    if(sim.countError()) {
+        printf("rehome     count still %d ticks off\n", sim.countError());
+        nFailures++;
+    }
+}
+
+// the host reading the dome position every poll, like TheSkyX does all night
+static void idle(int nSeconds, CddwDome &dome, CSimSerX &serx)
+{
+    double dStart = CVirtualClock::seconds();
+    std::chrono::steady_clock::time_point tStart = std::chrono::steady_clock::now();
+    DomeState state;
+
+    while(CVirtualClock::seconds() - dStart < nSeconds) {
+        sleeper.sleep(nPollMs);
+        if(!dome.getDomeState(state))
+            dome.getCurrentAz();
+    }
+    report("idle", 0, true, dStart, tStart, dome, serx);
+}
+
+int main(int argc, char **argv)
+{
+    CDomeSimulator sim;
+    DomeSimConfig config = sim.config();
+    CddwDome dome;
+    double dAz = 120;
+    int nCountError = 30;
+    int nIdleSeconds = DEFAULT_IDLE_SECONDS;
+    bool bAsync = false;
+    int nOpt;
+    int nErr;
+
+    while((nOpt = getopt(argc, argv, "p:a:e:i:sv")) != -1) {
+        switch(nOpt) {
+            case 'p' :  nPollMs = atoi(optarg); break;
+            case 'a' :  dAz = atof(optarg); break;
+            case 'e' :  nCountError = atoi(optarg); break;
+            case 'i' :  nIdleSeconds = atoi(optarg); break;
+            case 's' :  bAsync = true; break;
+            case 'v' :  dome.setLogLevel(DDW_LOG_VERBOSE); break;
+            default :
+                fprintf(stderr, "usage : %s [-p poll_ms] [-a az] [-e count_error_ticks] [-i idle_seconds] [-s] [-v]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    CVirtualClock::install();
+    if(bAsync)
+        CVirtualClock::expectThread();  // the plugin I/O thread, started by Connect
+    // start on the home sensor with a wrong count so Connect has to resync
+    sim.reset(config, config.nHomeTicks + nCountError);
+    sim.setCountError(nCountError);
+    CSimSerX serx(sim);
+    serx.setLatency(0.010);
+    dome.SetSerxPointer(&serx);
+    dome.setSleeper(&sleeper);
+    dome.setAsyncIO(bAsync);
+
+    std::chrono::steady_clock::time_point tTotal = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::time_point tStart = tTotal;
+
+    nErr = dome.Connect("sim");
+    report("connect", nErr, nErr == 0, 0.0, tStart, dome, serx);
+    if(dome.isResyncing()) {
+        // a host goto would turn the dome away from the home sensor, it has to wait
+        tStart = std::chrono::steady_clock::now();
+        nErr = dome.gotoAzimuth(dAz);
+        report("refused", nErr == ERR_COMMANDINPROGRESS ? 0 : (nErr ? nErr : -1), true, CVirtualClock::seconds(), tStart, dome, serx);
+        step("resync", 0, &CddwDome::isResyncComplete, dome, serx);
+    }
+
+    step("goto", dome.gotoAzimuth(dAz), &CddwDome::isGoToComplete, dome, serx);
+    step("open", dome.openShutter(), &CddwDome::isOpenComplete, dome, serx);
+    step("close", dome.closeShutter(), &CddwDome::isCloseComplete, dome, serx);
+    abortThenHome(dAz, dome, serx);
+    rehome(nCountError, sim, dome, serx);
+    step("park", dome.parkDome(), &CddwDome::isParkComplete, dome, serx);
+    idle(nIdleSeconds, dome, serx);
+
+    printf("total      virtual %.3f s  wall %.3f ms  simulated az %.2f  failures %d\n", CVirtualClock::seconds(),
+           std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - tTotal).count(),
+           sim.azimuth(), nFailures);
+
+    dome.Disconnect();
+    CVirtualClock::uninstall();
+    return nFailures ? 2 : 0;
+}
@@ -0,0 +1,167 @@
+//
+//  ddwSim.cpp
+//
+//  DDW controller simulator on a pseudo terminal (Linux).
+//  The slave side of the PTY is printed (and optionally symlinked) so the plugin can connect
+//  to it through the normal Connect() path, in TheSkyX or from the tools.
+//
+//  usage : ddwSim [-l link] [-s speed] [-a accel] [-c coast] [-t ticks] [-h home] [-p position]
+//                 [-e count_error] [-o shutter_s] [-k slip_up,slip_down] [-x timescale] [-1] [-T] [-r] [-v]
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#include <termios.h>
+#include <sys/select.h>
+
+#include <chrono>
+#include <string>
+
+#include "DomeSimulator.h"
+
+#define SIM_STEP_MS 10
+
+static volatile sig_atomic_t bQuit = 0;
+
+static void onSignal(int /*nSig*/)
+{
+    bQuit = 1;
+}
+
+static void printTraffic(const char *pszDir, const std::string &sData)
+{
+    size_t i;
+
+    printf("%s ", pszDir);
+    for(i = 0; i < sData.size(); i++) {
+        if(sData[i] == '\r')
+            printf("\\r");
+        else if(sData[i] == '\n')
+            printf("\\n");
+        else
+            putchar(sData[i]);
+    }
+    printf("\n");
+    fflush(stdout);
+}
+
+static void usage(const char *pszName)
+{
+    fprintf(stderr, "usage : %s [-l link] [-s speed] [-a accel] [-c coast] [-t ticks] [-h home] [-p position]\n"
+                    "                [-e count_error] [-o shutter_s] [-k slip_up,slip_down] [-x timescale] [-1] [-T] [-r] [-v]\n", pszName);
+}
+
+int main(int argc, char **argv)
+{
+    CDomeSimulator sim;
+    DomeSimConfig config = sim.config();
+    double dPosition = 526;
+    double dTimeScale = 1.0;
+    int nCountError = 0;
+    const char *pszLink = NULL;
+    const char *pszSlave;
+    bool bVerbose = false;
+    int nMaster;
+    int nSlave;
+    int nOpt;
+    int nLen;
+    char buf[256];
+    struct termios tio;
+    struct timeval tv;
+    fd_set fds;
+    std::string sOut;
+
+    while((nOpt = getopt(argc, argv, "l:s:a:c:t:h:p:e:o:k:x:1Trv")) != -1) {
+        switch(nOpt) {
+            case 'l' :  pszLink = optarg; break;
+            case 's' :  config.dMaxSpeed = atof(optarg); break;
+            case 'a' :  config.dAccel = atof(optarg); break;
+            case 'c' :  config.nCoastTicks = atoi(optarg); break;
+            case 't' :  config.nTicksPerRev = atoi(optarg); break;
+            case 'h' :  config.nHomeTicks = atoi(optarg); break;
+            case 'p' :  dPosition = atof(optarg); break;
+            case 'e' :  nCountError = atoi(optarg); break;
+            case 'o' :  config.dShutterTravel = atof(optarg); break;
+            case 'k' :  sscanf(optarg, "%lf,%lf", &config.dSlipUp, &config.dSlipDown); break;
+            case 'x' :  dTimeScale = atof(optarg); break;
+            case '1' :  config.nVersion = 1; break;
+            case 'T' :  config.bTickMessages = true; break;
+            case 'r' :  config.bBareStatus = true; break;
+            case 'v' :  bVerbose = true; break;
+            default :
+                usage(argv[0]);
+                return 1;
+        }
+    }
+    sim.reset(config, dPosition);
+    sim.setCountError(nCountError);     // lost count : the home sensor shows up that many ticks off
+
+    nMaster = posix_openpt(O_RDWR | O_NOCTTY);
+    if(nMaster < 0 || grantpt(nMaster) || unlockpt(nMaster) || !(pszSlave = ptsname(nMaster))) {
+        perror("can't create the pseudo terminal");
+        return 1;
+    }
+
+    // raw mode on the slave so the controller bytes go through untouched
+    nSlave = open(pszSlave, O_RDWR | O_NOCTTY);
+    if(nSlave < 0 || tcgetattr(nSlave, &tio)) {
+        perror(pszSlave);
+        return 1;
+    }
+    cfmakeraw(&tio);
+    cfsetispeed(&tio, B9600);
+    cfsetospeed(&tio, B9600);
+    tcsetattr(nSlave, TCSANOW, &tio);
+
+    if(pszLink) {
+        unlink(pszLink);
+        if(symlink(pszSlave, pszLink)) {
+            perror(pszLink);
+            return 1;
+        }
+    }
+    printf("DDW simulator on %s%s%s\n", pszSlave, pszLink ? " -> " : "", pszLink ? pszLink : "");
+    fflush(stdout);
+
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+
+    std::chrono::steady_clock::time_point tLast = std::chrono::steady_clock::now();
+    while(!bQuit) {
+        FD_ZERO(&fds);
+        FD_SET(nMaster, &fds);
+        tv.tv_sec = 0;
+        tv.tv_usec = SIM_STEP_MS * 1000;
+        if(select(nMaster + 1, &fds, NULL, NULL, &tv) > 0) {
+            nLen = (int)read(nMaster, buf, sizeof(buf));
+            if(nLen > 0) {
+                if(bVerbose)
+                    printTraffic(">", std::string(buf, nLen));
+                sim.input(buf, nLen);
+            }
+        }
+
+        std::chrono::steady_clock::time_point tNow = std::chrono::steady_clock::now();
+        sim.advance(std::chrono::duration<double>(tNow - tLast).count() * dTimeScale);
+        tLast = tNow;
+
+        if(sim.hasOutput()) {
+            sOut = sim.output();
+            if(bVerbose)
+                printTraffic("<", sOut);
+            if(write(nMaster, sOut.data(), sOut.size()) < 0 && errno != EAGAIN)
+                break;
+        }
+    }
+
+    if(pszLink)
+        unlink(pszLink);
+    close(nSlave);
+    close(nMaster);
+    return 0;
+}
@@ -28,12 +28,22 @@ X2Dome::X2Dome(const char* pszSelection,
     ddwDome.setSleeper(pSleeper);
 
     if (m_pIniUtil) {
+        ddwDome.setAsyncIO(m_pIniUtil->readInt(PARENT_KEY, CHILD_KEY_ASYNC_IO, false));
+        ddwDome.setLogLevel(m_pIniUtil->readInt(PARENT_KEY, CHILD_KEY_LOG_LEVEL, DDW_LOG_OFF));
+        ddwDome.setSerialTrace(m_pIniUtil->readInt(PARENT_KEY, CHILD_KEY_SERIAL_TRACE, false));
+        ddwDome.setCoastCompensation(m_pIniUtil->readInt(PARENT_KEY, CHILD_KEY_COAST_COMPENSATION, true));
+        char szModel[COAST_MODEL_SIZE];
+        m_pIniUtil->readString(PARENT_KEY, CHILD_KEY_COAST_MODEL, "", szModel, COAST_MODEL_SIZE);
+        ddwDome.setCoastModel(szModel);
     }
 }
 
 
 X2Dome::~X2Dome()
 {
+    // make sure the I/O thread is gone before the SerX goes away
+    ddwDome.Disconnect();
+
 	if (m_pSerX)
 		delete m_pSerX;
 	if (m_pTheSkyXForMounts)
@@ -63,18 +73,21 @@ int X2Dome::establishLink(void)
     m_bLinked = true;
     // try to connect
     nErr = ddwDome.Connect(szPort); // with hardware flow control (RTS/CTS)
-    if(nErr) {
+    if(nErr && nErr != ERR_ABORTEDPROCESS) {   // not if terminateLink cancelled it
         nErr = ddwDome.Connect(szPort, false); // without hardware flow control
-        if(nErr)
-            m_bLinked = false;
     }
+    if(nErr)
+        m_bLinked = false;
     return nErr;
 }
 
 int X2Dome::terminateLink(void)					
 {
+    // don't wait for a Connect or a command that is retrying to give up by itself
+    CCancelRequest cancel(ddwDome.cancelToken());
     X2MutexLocker ml(GetMutex());
     ddwDome.Disconnect();
+    saveCoastModel();
 	m_bLinked = false;
 	return SB_OK;
 }
@@ -140,6 +153,10 @@ int X2Dome::execModalSettingsDialog()
         dx->setText("ticksPerRev", "");
     }
 
+    dx->setChecked("asyncIO", ddwDome.isAsyncIO()?1:0);
+    dx->setChecked("serialTrace", ddwDome.isSerialTrace()?1:0);
+    dx->setCurrentIndex("logLevel", ddwDome.getLogLevel());
+
     mCalibratingDome = false;
     
     //Display the user interface
@@ -149,6 +166,18 @@ int X2Dome::execModalSettingsDialog()
     //Retreive values from the user interface
     if (bPressedOK)
     {
+        // takes effect on the next connection
+        ddwDome.setAsyncIO(dx->isChecked("asyncIO")?true:false);
+        if (m_pIniUtil)
+            m_pIniUtil->writeInt(PARENT_KEY, CHILD_KEY_ASYNC_IO, ddwDome.isAsyncIO()?1:0);
+        ddwDome.setSerialTrace(dx->isChecked("serialTrace")?true:false);
+        if (m_pIniUtil)
+            m_pIniUtil->writeInt(PARENT_KEY, CHILD_KEY_SERIAL_TRACE, ddwDome.isSerialTrace()?1:0);
+
+        // takes effect immediately
+        ddwDome.setLogLevel(dx->currentIndex("logLevel"));
+        if (m_pIniUtil)
+            m_pIniUtil->writeInt(PARENT_KEY, CHILD_KEY_LOG_LEVEL, ddwDome.getLogLevel());
     }
     return nErr;
 
@@ -199,6 +228,15 @@ void X2Dome::uiEvent(X2GUIExchangeInterface* uiex, const char* pszEvent)
         }
     }
 
+    if (!strcmp(pszEvent, "on_pushButtonStats_clicked"))
+    {
+        if(ddwDome.dumpCommandStats())
+            snprintf(errorMessage, LOG_BUFFER_SIZE, "Command statistics saved to %s", ddwDome.getCommandStatsPath().c_str());
+        else
+            snprintf(errorMessage, LOG_BUFFER_SIZE, "Can't write %s", ddwDome.getCommandStatsPath().c_str());
+        uiex->messageBox("ddwDome statistics", errorMessage);
+    }
+
     if (!strcmp(pszEvent, "on_pushButton_clicked"))
     {
         if(m_bLinked) {
@@ -272,6 +310,25 @@ double	X2Dome::driverInfoVersion(void) const
 
 int X2Dome::dapiGetAzEl(double* pdAz, double* pdEl)
 {
+    DomeState state;
+    bool bComplete;
+
+    // a home sensor resync started by Connect moves on with the host polls
+    if(ddwDome.isResyncing()) {
+        X2MutexLocker ml(GetMutex());
+        ddwDome.isResyncComplete(bComplete);
+    }
+
+    // read the published state without the X2 mutex so we don't queue behind a running command.
+    if(ddwDome.getDomeState(state)) {
+        if(!state.bConnected)
+            return ERR_NOLINK;
+        *pdAz = state.dAz;
+        *pdEl = state.dEl;
+        return SB_OK;
+    }
+
+    // state is too old, ask the dome
     X2MutexLocker ml(GetMutex());
 
     if(!m_bLinked)
@@ -301,9 +358,7 @@ int X2Dome::dapiGotoAzEl(double dAz, double dEl)
 
 int X2Dome::dapiAbort(void)
 {
-
-    X2MutexLocker ml(GetMutex());
-
+    // no X2 mutex, the STOP mustn't wait for the command in progress. CddwDome does its own locking.
     if(!m_bLinked)
         return ERR_NOLINK;
 
@@ -396,6 +451,8 @@ int X2Dome::dapiIsGotoComplete(bool* pbComplete)
         return ERR_NOLINK;
 
     nErr = ddwDome.isGoToComplete(*pbComplete);
+    if(*pbComplete || nErr)
+        saveCoastModel();   // learned from this goto
     if(nErr)
         return ERR_CMDFAILED;
     return SB_OK;
@@ -526,5 +583,12 @@ void X2Dome::portNameOnToCharPtr(char* pszPort, const int& nMaxSize) const
     
 }
 
+// the learned goto overshoot is kept in the ini, only written when it changed
+void X2Dome::saveCoastModel()
+{
+    if (m_pIniUtil && ddwDome.isCoastModelChanged())
+        m_pIniUtil->writeString(PARENT_KEY, CHILD_KEY_COAST_MODEL, ddwDome.getCoastModel().c_str());
+}
+
 
 
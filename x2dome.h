@@ -37,6 +37,12 @@ class TickCountInterface;
 #define CHILD_KEY_SHUTTER_CONTROL "ShutterCtrl"
 #define CHILD_KEY_SHUTTER_OPEN_UPPER_ONLY "ShutterOpenUpperOnly"
 #define CHILD_KEY_SHUTTER_OPER_ANY_Az "ShutterOperAnyAz"
+#define CHILD_KEY_ASYNC_IO "AsyncIO"
+#define CHILD_KEY_LOG_LEVEL "LogLevel"
+#define CHILD_KEY_SERIAL_TRACE "SerialTrace"
+#define CHILD_KEY_COAST_COMPENSATION "CoastCompensation"
+#define CHILD_KEY_COAST_MODEL "CoastModel"
+#define COAST_MODEL_SIZE 256
 
 #if defined(SB_WIN_BUILD)
 #define DEF_PORT_NAME					"COM1"
@@ -156,6 +162,7 @@ private:
 	TickCountInterface								*	m_pTickCount;
 
     void portNameOnToCharPtr(char* pszPort, const int& nMaxSize) const;
+    void saveCoastModel();
 
 
 	int         m_nPrivateISIndex;